@@ -0,0 +1,174 @@
+#include "any_vocoder.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "pipelined_vocoder.hpp"
+#include "harmonizer.hpp"
+
+namespace {
+    template<u32 win, u32 ovl>
+    class vocoder_impl final : public any_vocoder {
+        using vocoder_t = multichannel_vocoder<win, ovl>;
+        using pipeline_t = pipelined_vocoder<win, ovl>;
+        using hop_chunk = typename vocoder_t::hop_chunk;
+        static constexpr u32 hop = vocoder_t::hop_size;
+
+        vocoder_t v;
+        std::unique_ptr<pipeline_t> pipeline;
+        //the pipeline's own bypass: its stages keep going meanwhile, so that the way back is a crossfade too
+        bypass_switch<hop> pipeline_bypass;
+        telemetry::audio_stats* stats = nullptr;
+        //planar copies of the hops going through process_hop()
+        std::vector<hop_chunk> in_hops, out_hops;
+        //process() re-blocks itself when pipelined, since the pipeline only takes hops
+        hop_reblocker<hop> reblocker;
+
+        void run_hop(std::span<const hop_chunk> in, std::span<hop_chunk> out) {
+            if(pipeline) {
+                const telemetry::scoped_timer timer(stats, telemetry::stage::hop);
+                pipeline_bypass.begin_hop(in);
+                pipeline->process_hop(in, out);
+                pipeline_bypass.end_hop(out);
+            } else v.process_hop(in, out);
+        }
+    public:
+        vocoder_impl(u16 channels, channel_mode mode, u32 threads, bool pipelined)
+            : v(channels, mode, pipelined ? 1 : threads), pipeline_bypass(channels, vocoder_t::delay_hops + pipeline_t::stages, 0),
+              in_hops(channels), out_hops(channels), reblocker(channels) {
+            if(pipelined) pipeline = std::make_unique<pipeline_t>(v);
+        }
+
+        u32 window_size() const override { return win; }
+        u32 overlap() const override { return ovl; }
+        u32 latency() const override { return pipeline ? pipeline_t::latency() : vocoder_t::latency(); }
+        u16 channels() const override { return v.channels(); }
+        u32 threads() const override { return pipeline ? v.threads() + pipeline_t::stages : v.threads(); }
+        bool is_pipelined() const override { return bool(pipeline); }
+
+        void set_pitch_factor(f32 f) override { v.set_pitch_factor(f); }
+        void set_pitch_semitones(f32 semitones) override { set_pitch_factor(std::pow(2.f, semitones / 12.f)); }
+        void set_window(dft::window_type t) override { v.set_window(t); }
+        void set_bypass(bool b) override {
+            if(pipeline) pipeline_bypass.set(b);
+            else v.set_bypass(b);
+        }
+        void set_gate(f32 threshold) override { v.set_gate(threshold); }
+        void set_stats(telemetry::audio_stats* s) override {
+            stats = s;
+            if(!pipeline) v.set_stats(s);
+        }
+
+        void reset() override {
+            //the hops still in the pipeline are dropped along with it
+            const bool pipelined = bool(pipeline);
+            pipeline.reset();
+            v.reset();
+            pipeline_bypass.reset();
+            reblocker.reset();
+            if(pipelined) pipeline = std::make_unique<pipeline_t>(v);
+        }
+
+        void process(std::span<const f32> in, std::span<f32> out) override {
+            if(!pipeline) return v.process(in, out);
+            reblocker.process(in, out, [this](std::span<const hop_chunk> i, std::span<hop_chunk> o) { run_hop(i, o); });
+        }
+
+        void process_hop(std::span<const f32* const> in, std::span<f32* const> out) override {
+            for(u16 c = 0; c < v.channels(); c++)
+                std::copy(in[c], in[c] + hop, in_hops[c].begin());
+            run_hop(in_hops, out_hops);
+            for(u16 c = 0; c < v.channels(); c++)
+                std::copy(out_hops[c].begin(), out_hops[c].end(), out[c]);
+        }
+
+        void magnitudes(std::span<f32> out) override {
+            if(!pipeline) {
+                v.refresh_spectrum(0);
+                const auto& spectrum = v.channel(0).spectrum();
+                const f32 *re = spectrum.real_data(), *im = spectrum.imag_data();
+                for(u32 i = 0; i < bins(); i++)
+                    out[i] = std::hypot(re[i], im[i]);
+            } else if(const typename vocoder_t::frame* f = pipeline->last_frame(0))
+                std::copy(f->magnitude.begin(), f->magnitude.end(), out.begin());
+            else std::fill(out.begin(), out.begin() + bins(), 0.f);
+        }
+    };
+
+    template<u32 win, u32 ovl>
+    class harmonizer_impl final : public any_vocoder {
+        using harmonizer_t = harmonizer<win, ovl>;
+        using hop_chunk = typename harmonizer_t::hop_chunk;
+        static constexpr u32 hop = harmonizer_t::hop_size;
+
+        harmonizer_t h;
+        //planar copies of the hops going through process_hop()
+        std::vector<hop_chunk> in_hops, out_hops;
+    public:
+        harmonizer_impl(u16 channels, std::span<const harmony_voice> voices) : h(channels, voices), in_hops(channels), out_hops(channels) {}
+
+        u32 window_size() const override { return win; }
+        u32 overlap() const override { return ovl; }
+        u32 latency() const override { return harmonizer_t::latency(); }
+        u16 channels() const override { return h.channels(); }
+        u32 threads() const override { return 1; }
+        bool is_pipelined() const override { return false; }
+
+        void set_pitch_factor(f32 f) override { h.set_pitch_factor(f); }
+        void set_pitch_semitones(f32 semitones) override { set_pitch_factor(std::pow(2.f, semitones / 12.f)); }
+        void set_window(dft::window_type t) override { h.set_window(t); }
+        void reset() override { h.reset(); }
+        void set_bypass(bool b) override { h.set_bypass(b); }
+        void set_gate(f32 threshold) override { h.set_gate(threshold); }
+        void set_stats(telemetry::audio_stats* s) override { h.set_stats(s); }
+
+        void process(std::span<const f32> in, std::span<f32> out) override { h.process(in, out); }
+
+        void process_hop(std::span<const f32* const> in, std::span<f32* const> out) override {
+            for(u16 c = 0; c < h.channels(); c++)
+                std::copy(in[c], in[c] + hop, in_hops[c].begin());
+            h.process_hop(in_hops, out_hops);
+            for(u16 c = 0; c < h.channels(); c++)
+                std::copy(out_hops[c].begin(), out_hops[c].end(), out[c]);
+        }
+
+        void magnitudes(std::span<f32> out) override {
+            h.refresh_spectrum(0);
+            const auto& spectrum = h.spectrum(0);
+            const f32 *re = spectrum.real_data(), *im = spectrum.imag_data();
+            for(u32 i = 0; i < bins(); i++)
+                out[i] = std::hypot(re[i], im[i]);
+        }
+    };
+
+    //instantiates impl<win, overlap> for the (window size, overlap) pair asked for, out of every pair there is an
+    //instantiation for
+    template<template<u32, u32> class impl, std::size_t... wi, std::size_t... oi>
+    std::unique_ptr<any_vocoder> make_impl(std::index_sequence<wi...>, std::index_sequence<oi...>, u32 win, u32 overlap, auto&&... args) {
+        std::unique_ptr<any_vocoder> ret;
+        auto try_window = [&]<u32 w>() {
+            ((w == win && any_vocoder::overlaps[oi] == overlap
+                ? void(ret = std::make_unique<impl<w, any_vocoder::overlaps[oi]>>(args...))
+                : void()), ...);
+        };
+        (try_window.template operator()<any_vocoder::window_sizes[wi]>(), ...);
+        if(!ret)
+            throw std::out_of_range("unsupported window size and overlap: " + std::to_string(win) + ", " + std::to_string(overlap)
+                + " (the window size can be 256, 512, 1024, 2048, 4096 or 8192 and the overlap 2, 4 or 8)");
+        return ret;
+    }
+    template<template<u32, u32> class impl>
+    std::unique_ptr<any_vocoder> make_impl(u32 win, u32 overlap, auto&&... args) {
+        return make_impl<impl>(std::make_index_sequence<any_vocoder::window_sizes.size()>(),
+            std::make_index_sequence<any_vocoder::overlaps.size()>(), win, overlap, args...);
+    }
+}
+
+std::unique_ptr<any_vocoder> make_vocoder(u32 win, u32 overlap, u16 channels, channel_mode mode, u32 threads, bool pipelined) {
+    return make_impl<vocoder_impl>(win, overlap, channels, mode, threads, pipelined);
+}
+
+std::unique_ptr<any_vocoder> make_harmonizer(u32 win, u32 overlap, u16 channels, std::span<const harmony_voice> voices) {
+    return make_impl<harmonizer_impl>(win, overlap, channels, voices);
+}
@@ -0,0 +1,66 @@
+#ifndef ANY_VOCODER_HPP
+#define ANY_VOCODER_HPP
+
+#include <array>
+#include <memory>
+#include <span>
+#include <scluk/aliases.hpp>
+#include "dft/window.hpp"
+#include "multichannel_vocoder.hpp"
+#include "harmonizer.hpp"
+
+// a multichannel vocoder whose window size and overlap are picked at runtime: make_vocoder() instantiates the
+// multichannel_vocoder (and pipelined_vocoder) of the requested sizes out of a fixed set of precompiled ones, and
+// make_harmonizer() does the same with harmonizer, so all the per-hop loops keep their compile time sizes and only the
+// calls through this interface (one per hop or per block) are virtual
+class any_vocoder {
+public:
+    //the sizes make_vocoder() knows
+    static constexpr std::array<u32, 6> window_sizes { 256, 512, 1024, 2048, 4096, 8192 };
+    static constexpr std::array<u32, 3> overlaps { 2, 4, 8 };
+
+    virtual ~any_vocoder() = default;
+
+    virtual u32 window_size() const = 0;
+    virtual u32 overlap() const = 0;
+    u32 hop_size() const { return window_size() / overlap(); }
+    u32 bins() const { return window_size() / 2 + 1; }
+    //samples between an input sample and the corresponding output, pipeline included
+    virtual u32 latency() const = 0;
+    virtual u16 channels() const = 0;
+    //threads processing a hop, counting the caller's
+    virtual u32 threads() const = 0;
+    virtual bool is_pipelined() const = 0;
+
+    virtual void set_pitch_factor(f32 f) = 0;
+    virtual void set_pitch_semitones(f32 semitones) = 0;
+    virtual void set_window(dft::window_type t) = 0;
+    virtual void reset() = 0;
+    // see multichannel_vocoder::set_bypass() and set_gate(). Pipelined vocoders have no gate: their stages keep
+    // processing, and while bypassed their output is crossfaded to the delay line
+    virtual void set_bypass(bool b) = 0;
+    virtual void set_gate(f32 threshold) = 0;
+    // times the stages of every hop into stats (null for none; see multichannel_vocoder::set_stats()). A pipeline only
+    // times its hops as a whole, waiting for the stages included
+    virtual void set_stats(telemetry::audio_stats* stats) = 0;
+
+    // any number of interleaved frames; out must be as long as in (and may be the same memory)
+    virtual void process(std::span<const f32> in, std::span<f32> out) = 0;
+    // a hop of every channel: in[c] and out[c] point to hop_size() samples of channel c (and may be the same memory)
+    virtual void process_hop(std::span<const f32* const> in, std::span<f32* const> out) = 0;
+    // writes the bins() magnitudes of the latest spectrum of the first channel (the mid, in mid/side mode) to out,
+    // transforming the latest window first if it was bypassed or gated
+    virtual void magnitudes(std::span<f32> out) = 0;
+};
+
+// throws std::out_of_range if the window size or the overlap isn't one of the precompiled ones, and
+// std::runtime_error if the channels don't suit the mode. A pipelined vocoder (see pipelined_vocoder.hpp) runs its
+// stages on threads of its own and ignores threads
+std::unique_ptr<any_vocoder> make_vocoder(u32 win, u32 overlap, u16 channels, channel_mode mode = channel_mode::independent,
+    u32 threads = 1, bool pipelined = false);
+
+// a harmonizer (see harmonizer.hpp) of the given voices behind the same interface: its pitch transposes all the voices
+// together, and its magnitudes are those of the input. Throws like make_vocoder()
+std::unique_ptr<any_vocoder> make_harmonizer(u32 win, u32 overlap, u16 channels, std::span<const harmony_voice> voices);
+
+#endif //ANY_VOCODER_HPP
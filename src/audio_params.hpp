@@ -2,52 +2,172 @@
 #define AUDIO_PARAMS_HPP
 
 #include <scluk/aliases.hpp>
-#include <scluk/array.hpp>
 #include <boost/fiber/buffered_channel.hpp>
+#include <array>
+#include <atomic>
 #include <bit>
+#include <memory>
+#include <span>
+#include <thread>
+#include <chrono>
+#include <vector>
 #include "portaudio/stream_wrapper.hpp"
-#include "dft/sliding_dft.hpp"
+#include "any_vocoder.hpp"
+#include "lockfree/spsc_ring.hpp"
+#include "telemetry/stats.hpp"
 
 namespace audio {
-    using scluk::u64, scluk::f32, scluk::heap_array;
+    using scluk::u64, scluk::f32;
+    //defaults of the interactive mode, which the command line can override (see offline::usage())
     #ifndef LOWER_PERFORMANCE_MODE
     constexpr u64 ft_win = 1024;
     constexpr u64 rate = ft_win*50;//~40-50k
     constexpr u64 ift_overlap = 4;
-    constexpr u64 ft_dist = ft_win / ift_overlap;
     #else
     constexpr u64 rate = 10000;
     constexpr u64 ft_win = 512;
     constexpr u64 ift_overlap = 4;
-    constexpr u64 ft_dist = ft_win / ift_overlap;
     #endif
-    using sliding_dft = dft::sliding_dft<f32, ft_win>;
-    using dft_array = sliding_dft::dft_array;
-    using frame_chunk = scluk::heap_array<f32, ft_dist>;
-    using ift_chunk = scluk::heap_array<f32, ft_win>;
-    using gui_simplex_chan = boost::fibers::buffered_channel<dft_array>;
+    //frames per host buffer; 0 (paFramesPerBufferUnspecified) lets the device pick whatever suits it best, since the
+    //callback re-blocks the samples into hops anyway
+    constexpr u64 host_buffer = 0;
+    //interleaved channels of the stream; a stereo pair goes through phase locked mid/side processing
+    constexpr u16 channels = 2;
+    //magnitudes of a spectrum, on their way to the gui
+    using spectrum_buffer = std::vector<f32>;
+    using gui_simplex_chan = boost::fibers::buffered_channel<spectrum_buffer>;
 
-    static_assert(std::has_single_bit(ft_win), "ft_win must be a power of two to allow us to use cooley-tukey ifft");
+    //samples travelling between the portaudio callback and the processing thread, through wait-free rings, one per
+    //channel (the callback de-interleaves its input and re-interleaves its output): the callback never blocks, it
+    //counts the events where it had to drop input or had no output to play.
+    //The rings hold loose samples, so the host buffers can have any size: the processing thread takes them out one hop
+    //at a time. When a host buffer is bigger than a hop the first callbacks underrun once, after which the output
+    //rings settle at one host buffer of latency. Every push and pop covers all the channels or none of them, so they
+    //never get out of step.
+    struct duplex_ring {
+        //4 hops of the biggest window with the least overlap; host buffers bigger than this are always dropped
+        static constexpr u64 capacity = std::bit_ceil(u64(any_vocoder::window_sizes.back()) * 2);
+        using ring = lockfree::spsc_ring<f32, capacity>;
 
-    struct duplex_chan {
-        boost::fibers::buffered_channel<audio::frame_chunk> cb_to_main, main_to_cb;
-        duplex_chan(u64 cb_to_main_sz=2, u64 main_to_cb_sz=2) : cb_to_main(cb_to_main_sz), main_to_cb(main_to_cb_sz) {}
+        const u16 channels;
+        const u64 hop;
+        std::unique_ptr<ring[]> cb_to_main, main_to_cb;
+        std::atomic<u64> overruns = 0, underruns = 0;
+        //what portaudio reported through the status flags of the callbacks
+        std::atomic<u64> input_underflows = 0, input_overflows = 0, output_underflows = 0, output_overflows = 0;
+        //where the callback times itself, if anywhere
+        telemetry::audio_stats* stats = nullptr;
+        //what the callback plays when the processing thread is late
+        enum class underrun_policy { silence, repeat } on_underrun = underrun_policy::silence;
+        //the last hop worth of frames played, planar, as circular buffers starting at last_out_pos (only kept for repeat)
+        std::vector<f32> last_out;
+        u64 last_out_pos = 0;
+
+        duplex_ring(u16 channels, u64 hop)
+            : channels(channels), hop(hop), cb_to_main(new ring[channels]), main_to_cb(new ring[channels]), last_out(channels * hop, 0.f) {
+            //one hop of slack between the callback and the processing thread
+            for(u16 c = 0; c < channels; c++)
+                main_to_cb[c].push(std::span<const f32>(last_out.data(), hop));
+        }
+
+        //frames that can be pushed to / popped from every channel of rings (by their producer / consumer)
+        u64 space(ring* rings) const {
+            u64 n = capacity;
+            for(u16 c = 0; c < channels; c++) n = std::min<u64>(n, rings[c].space());
+            return n;
+        }
+        u64 ready(const ring* rings) const {
+            u64 n = capacity;
+            for(u16 c = 0; c < channels; c++) n = std::min<u64>(n, rings[c].size());
+            return n;
+        }
+
+        //callback side
+        void fill_gap(f32* o_buf, u64 frames) {
+            if(on_underrun == underrun_policy::silence)
+                return std::fill(o_buf, o_buf + frames * channels, 0.f);
+            for(u64 i = 0; i < frames; i++)
+                for(u16 c = 0; c < channels; c++)
+                    o_buf[i * channels + c] = last_out[c * hop + (last_out_pos + i) % hop];
+        }
+        void remember_output(const f32* o_buf, u64 frames) {
+            if(on_underrun != underrun_policy::repeat) return;
+            for(u64 i = frames - std::min(frames, hop); i < frames; i++) {
+                for(u16 c = 0; c < channels; c++)
+                    last_out[c * hop + last_out_pos] = o_buf[i * channels + c];
+                last_out_pos = (last_out_pos + 1) % hop;
+            }
+        }
+
+        //processing thread side, a hop at a time into / out of chunk[c] for every channel c; these wait by polling,
+        //returning false if stop() becomes true first
+        bool pop_input(std::span<f32* const> chunk, auto&& stop) {
+            using namespace std::chrono_literals;
+            while(ready(cb_to_main.get()) < hop)
+                if(stop()) return false;
+                else std::this_thread::sleep_for(200us);
+            for(u16 c = 0; c < channels; c++)
+                cb_to_main[c].pop(std::span<f32>(chunk[c], hop));
+            return true;
+        }
+        bool push_output(std::span<const f32* const> chunk, auto&& stop) {
+            using namespace std::chrono_literals;
+            while(space(main_to_cb.get()) < hop)
+                if(stop()) return false;
+                else std::this_thread::sleep_for(200us);
+            for(u16 c = 0; c < channels; c++)
+                main_to_cb[c].push(std::span<const f32>(chunk[c], hop));
+            return true;
+        }
     };
 
-    int cb(const void* v_i_buf, void* v_o_buf, [[maybe_unused]]u64 frames, auto, auto, void* userdata) {
-        using namespace std::chrono_literals;
-        assert(frames == audio::ft_dist && "You were my brother Anakin");
-        auto& chans = *reinterpret_cast<audio::duplex_chan*>(userdata);
+    int cb(const void* v_i_buf, void* v_o_buf, u64 frames, auto, PaStreamCallbackFlags status, void* userdata) {
+        auto& ring = *reinterpret_cast<audio::duplex_ring*>(userdata);
+        const telemetry::clk::time_point start = ring.stats ? telemetry::clk::now() : telemetry::clk::time_point();
+        if(status & paInputUnderflow) ring.input_underflows.fetch_add(1, std::memory_order_relaxed);
+        if(status & paInputOverflow) ring.input_overflows.fetch_add(1, std::memory_order_relaxed);
+        if(status & paOutputUnderflow) ring.output_underflows.fetch_add(1, std::memory_order_relaxed);
+        if(status & paOutputOverflow) ring.output_overflows.fetch_add(1, std::memory_order_relaxed);
+
         const f32* i_buf = reinterpret_cast<const f32*>(v_i_buf);
         f32* o_buf = reinterpret_cast<f32*>(v_o_buf);
-        audio::frame_chunk to_main, to_pa;
+        const u16 channels = ring.channels;
+        //samples are (de-)interleaved through this, a slice of one channel at a time
+        std::array<f32, 256> slice;
+
+        if(ring.space(ring.cb_to_main.get()) >= frames) {
+            for(u64 f = 0; f < frames; f += slice.size()) {
+                const u64 n = std::min<u64>(slice.size(), frames - f);
+                for(u16 c = 0; c < channels; c++) {
+                    for(u64 i = 0; i < n; i++)
+                        slice[i] = i_buf[(f + i) * channels + c];
+                    ring.cb_to_main[c].push(std::span<const f32>(slice.data(), n));
+                }
+            }
+        } else ring.overruns.fetch_add(1, std::memory_order_relaxed);
 
-        std::copy(i_buf, i_buf + to_main.size(), to_main.begin());
-        chans.cb_to_main.push_wait_for(std::move(to_main), 100ms);
+        //play whatever is ready, and patch the rest
+        const u64 ready = std::min(frames, ring.ready(ring.main_to_cb.get()));
+        for(u64 f = 0; f < ready; f += slice.size()) {
+            const u64 n = std::min<u64>(slice.size(), ready - f);
+            for(u16 c = 0; c < channels; c++) {
+                ring.main_to_cb[c].pop(std::span<f32>(slice.data(), n));
+                for(u64 i = 0; i < n; i++)
+                    o_buf[(f + i) * channels + c] = slice[i];
+            }
+        }
+        if(ready < frames) {
+            ring.underruns.fetch_add(1, std::memory_order_relaxed);
+            ring.fill_gap(o_buf + ready * channels, frames - ready);
+        }
+        ring.remember_output(o_buf, frames);
 
-        chans.main_to_cb.pop_wait_for(to_pa, 100ms);
-        std::copy(to_pa.begin(), to_pa.end(), o_buf);
-        
+        if(ring.stats) {
+            const telemetry::clk::time_point end = telemetry::clk::now();
+            ring.stats->record(telemetry::stage::callback, 0, start, end);
+            if(end - start > std::chrono::duration<double, std::nano>(double(frames) * ring.stats->frame_ns))
+                ring.stats->late_callbacks.fetch_add(1, std::memory_order_relaxed);
+        }
         return paContinue;
     }
 }
@@ -0,0 +1,243 @@
+#include "batch_runner.hpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <scluk/language_extension.hpp>
+#include "work_stealing_pool.hpp"
+#include "../any_vocoder.hpp"
+
+namespace batch {
+    namespace {
+        namespace fs = std::filesystem;
+        using namespace scluk::language_extension;
+        using clk = std::chrono::steady_clock;
+
+        //frames rendered before a chunk's first frame to let the vocoders settle, and frames crossfaded at seams
+        u64 pre_roll_of(const offline::options& opts) { return 4 * opts.win; }
+        u64 crossfade_of(const offline::options& opts) { return opts.win; }
+
+        //everything a worker needs to process a chunk, allocated by the first chunk it gets and reused afterwards
+        struct worker_state {
+            //the workers already run in parallel, so the channels of a chunk are processed one after the other
+            std::unique_ptr<any_vocoder> vocoder;
+            channel_mode mode = channel_mode::independent;
+            std::vector<f32> interleaved, processed, head, tail;
+
+            void prepare(u16 channels, const offline::options& opts) {
+                if(!vocoder || vocoder->channels() != channels || mode != opts.mode_for(channels)
+                    || vocoder->window_size() != opts.win || vocoder->overlap() != opts.overlap) {
+                    mode = opts.mode_for(channels);
+                    vocoder = offline::vocoder_for(opts, channels, 1);
+                } else vocoder->reset();
+                vocoder->set_pitch_semitones(opts.semitones);
+                vocoder->set_window(opts.window);
+                interleaved.resize(opts.block_frames * channels);
+                processed.resize(opts.block_frames * channels);
+                head.resize(crossfade_of(opts) * channels);
+                tail.resize(crossfade_of(opts) * channels);
+            }
+        };
+
+        //the crossfade between two chunks: both render it, faded, and whichever finishes second sums and writes it
+        struct seam {
+            std::mutex m;
+            std::vector<f32> first_half;
+            bool one_done = false;
+        };
+
+        struct file_job {
+            fs::path in, out;
+            std::unique_ptr<file::audio_reader> reader;
+            std::unique_ptr<file::audio_block_writer> writer;
+            std::once_flag writer_created;
+            u64 chunk_frames = 0;
+            u32 chunks = 1;
+            std::unique_ptr<seam[]> seams;
+            std::atomic<u32> remaining;
+            std::atomic<i64> start_ns = std::numeric_limits<i64>::max();
+            std::atomic<bool> failed = false;
+        };
+
+        struct totals_t {
+            std::mutex m;
+            f64 audio_s = 0.;
+            u64 samples = 0;
+            u32 files = 0, failures = 0;
+        };
+
+        bool is_audio_path(const fs::path& p) {
+            const std::string ext = p.extension().string();
+            return file::is_wav_path(p) || ext == ".raw" || ext == ".f32";
+        }
+
+        //every (input, output) pair the inputs expand to
+        std::vector<std::pair<fs::path, fs::path>> collect_files(const offline::options& opts) {
+            std::vector<std::pair<fs::path, fs::path>> files;
+            for(const fs::path& in : opts.in) {
+                if(fs::is_directory(in)) {
+                    std::vector<fs::path> found;
+                    for(const fs::directory_entry& e : fs::recursive_directory_iterator(in))
+                        if(e.is_regular_file() && is_audio_path(e.path()))
+                            found.push_back(e.path());
+                    std::sort(found.begin(), found.end());
+                    for(const fs::path& p : found)
+                        files.emplace_back(p, opts.out / fs::relative(p, in));
+                } else files.emplace_back(in, opts.out / in.filename());
+            }
+            return files;
+        }
+
+        void write_seam(file_job& job, seam& s, u64 first_frame, std::span<const f32> part) {
+            std::lock_guard lock(s.m);
+            if(!s.one_done) {
+                s.first_half.assign(part.begin(), part.end());
+                s.one_done = true;
+                return;
+            }
+            for(u64 i = 0; i < part.size(); i++)
+                s.first_half[i] += part[i];
+            job.writer->write(first_frame, s.first_half);
+            s.first_half = {};
+        }
+
+        void process_chunk(file_job& job, u32 k, worker_state& ws, const offline::options& opts, std::span<const f32> fade_in) {
+            const file::audio_reader& reader = *job.reader;
+            const u16 channels = reader.format().channels;
+            ws.prepare(channels, opts);
+            const u64 frames = reader.frames(), latency = ws.vocoder->latency(), block = opts.block_frames;
+            const u64 pre_roll = pre_roll_of(opts), crossfade = crossfade_of(opts);
+            const bool first_chunk = k == 0, last_chunk = k + 1 == job.chunks;
+
+            //frames [a, b) are this chunk's own; the next crossfade frames are rendered too unless this is the last one
+            const u64 a = k * job.chunk_frames, b = last_chunk ? frames : a + job.chunk_frames;
+            const u64 render_end = last_chunk ? b : b + crossfade;
+            //input [s, feed_end) (zeros past the end of the file) comes out as frames [s - latency, render_end)
+            const u64 s = a - std::min(a, pre_roll), feed_end = render_end + latency;
+
+            for(u64 f = s; f < feed_end; f += block) {
+                const u64 n = std::min(block, feed_end - f), avail = f < frames ? std::min(n, frames - f) : 0;
+                if(avail) reader.read(f, avail, ws.interleaved);
+                std::fill(ws.interleaved.begin() + i64(avail * channels), ws.interleaved.begin() + i64(n * channels), 0.f);
+
+                ws.vocoder->process(std::span<const f32>(ws.interleaved.data(), n * channels), std::span<f32>(ws.processed.data(), n * channels));
+
+                //sample i of the block is frame f + i - latency: hands fn the samples of the block in frames [r0, r1)
+                auto for_range = [&](u64 r0, u64 r1, auto&& fn) {
+                    auto index_of = [&](u64 t) { return t + latency > f ? std::min(n, t + latency - f) : 0; };
+                    const u64 i0 = index_of(r0), i1 = index_of(r1);
+                    if(i0 < i1)
+                        fn(f + i0 - latency, std::span<const f32>(&ws.processed[i0 * channels], (i1 - i0) * channels));
+                };
+
+                const u64 direct_begin = first_chunk ? a : a + crossfade;
+                if(!first_chunk)
+                    for_range(a, a + crossfade, [&](u64 t, std::span<const f32> src) {
+                        for(u64 j = 0; j < src.size(); j++)
+                            ws.head[(t - a) * channels + j] = src[j] * fade_in[t - a + j / channels];
+                    });
+                for_range(direct_begin, b, [&](u64 t, std::span<const f32> src) { job.writer->write(t, src); });
+                if(!last_chunk)
+                    for_range(b, render_end, [&](u64 t, std::span<const f32> src) {
+                        for(u64 j = 0; j < src.size(); j++)
+                            ws.tail[(t - b) * channels + j] = src[j] * fade_in[crossfade - 1 - (t - b + j / channels)];
+                    });
+            }
+
+            if(!first_chunk) write_seam(job, job.seams[k - 1], a, ws.head);
+            if(!last_chunk) write_seam(job, job.seams[k], b, ws.tail);
+            //the next chunk's pre-roll reads the end of this one again
+            reader.release(a, (b - a) - std::min(b - a, pre_roll));
+        }
+    }
+
+    u32 run(const offline::options& opts) {
+        const auto start = clk::now();
+        auto now_ns = [start] { return i64(std::chrono::duration_cast<std::chrono::nanoseconds>(clk::now() - start).count()); };
+
+        //raised cosine crossfade, whose two halves always sum to 1; the fade out is the fade in reversed
+        const u64 crossfade = crossfade_of(opts);
+        std::vector<f32> fade_in(crossfade);
+        for(u64 i = 0; i < crossfade; i++) {
+            const f64 s = std::sin(1.5707963267948966 * (f64(i) + .5) / f64(crossfade));
+            fade_in[i] = f32(s * s);
+        }
+
+        const std::vector<std::pair<fs::path, fs::path>> files = collect_files(opts);
+        std::vector<std::unique_ptr<file_job>> jobs;
+        totals_t totals;
+        for(const auto& [in_path, out_path] : files) {
+            auto job = std::make_unique<file_job>();
+            job->in = in_path;
+            job->out = out_path;
+            try {
+                job->reader = std::make_unique<file::audio_reader>(in_path, opts.raw_format);
+            } catch(const std::exception& e) {
+                out("%: %", in_path.string(), e.what());
+                totals.failures++;
+                continue;
+            }
+            const u64 frames = job->reader->frames();
+            job->chunk_frames = std::max<u64>(u64(opts.chunk_seconds * f64(job->reader->format().rate)), pre_roll_of(opts));
+            //the last chunk takes the remainder, so that every chunk is at least as long as a crossfade
+            job->chunks = u32(std::max<u64>(frames / job->chunk_frames, 1));
+            job->seams.reset(new seam[job->chunks]);
+            job->remaining = job->chunks;
+            jobs.push_back(std::move(job));
+        }
+
+        work_stealing_pool pool(opts.threads);
+        std::vector<worker_state> workers(pool.size());
+        for(const std::unique_ptr<file_job>& job_ptr : jobs)
+            for(u32 k = 0; k < job_ptr->chunks; k++)
+                pool.submit([&, job = job_ptr.get(), k](u32 worker) {
+                    i64 t0 = now_ns(), earliest = job->start_ns.load();
+                    while(t0 < earliest && !job->start_ns.compare_exchange_weak(earliest, t0)) {}
+
+                    try {
+                        if(!job->failed) {
+                            std::call_once(job->writer_created, [&] {
+                                const file::audio_format& fmt = job->reader->format();
+                                fs::create_directories(job->out.parent_path());
+                                job->writer = std::make_unique<file::audio_block_writer>(job->out, fmt.rate, fmt.channels, job->reader->frames(), file::is_wav_path(job->out));
+                            });
+                            process_chunk(*job, k, workers[worker], opts, fade_in);
+                        }
+                    } catch(const std::exception& e) {
+                        if(!job->failed.exchange(true)) {
+                            std::lock_guard lock(totals.m);
+                            out("%: %", job->in.string(), e.what());
+                            totals.failures++;
+                        }
+                    }
+
+                    if(job->remaining.fetch_sub(1) == 1 && !job->failed) {
+                        const file::audio_format& fmt = job->reader->format();
+                        const f64 wall_s = f64(now_ns() - job->start_ns.load()) * 1e-9;
+                        const f64 audio_s = f64(job->reader->frames()) / f64(fmt.rate);
+                        std::lock_guard lock(totals.m);
+                        try {
+                            job->writer->close();
+                        } catch(const std::exception& e) {
+                            out("%: %", job->out.string(), e.what());
+                            totals.failures++;
+                            return;
+                        }
+                        out("%: % s of audio in % chunks, % s, % x realtime", job->out.string(), audio_s, job->chunks, wall_s, audio_s / wall_s);
+                        totals.audio_s += audio_s;
+                        totals.samples += job->reader->frames() * fmt.channels;
+                        totals.files++;
+                    }
+                });
+        pool.run();
+
+        const f64 wall_s = f64(now_ns()) * 1e-9;
+        out("% files (% failed), % s of audio in % s on % threads: % x realtime (% x per thread), % samples/s",
+            totals.files, totals.failures, totals.audio_s, wall_s, pool.size(), totals.audio_s / wall_s,
+            totals.audio_s / wall_s / f64(pool.size()), f64(totals.samples) / wall_s);
+        return totals.failures;
+    }
+}
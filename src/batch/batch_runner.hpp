@@ -0,0 +1,18 @@
+#ifndef BATCH_BATCH_RUNNER_HPP
+#define BATCH_BATCH_RUNNER_HPP
+
+#include "../offline.hpp"
+
+namespace batch {
+    using namespace scluk::type_aliases;
+
+    // processes every input file (and every .wav/.raw/.f32 file under every input directory) of opts into the
+    // opts.out directory, keeping the layout of the input directories, on opts.threads worker threads. Files longer
+    // than opts.chunk_seconds are split in chunks processed independently: each chunk starts the vocoders a few
+    // windows early (pre-roll), so they are settled by the time its first frame comes out, and adjacent chunks render
+    // one window of overlap that is crossfaded, hiding the phase discontinuity between them. Prints the throughput of
+    // every file as it is finished and the aggregate one at the end; returns the number of files that failed.
+    u32 run(const offline::options& opts);
+}
+
+#endif //BATCH_BATCH_RUNNER_HPP
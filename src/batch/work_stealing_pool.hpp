@@ -0,0 +1,95 @@
+#ifndef BATCH_WORK_STEALING_POOL_HPP
+#define BATCH_WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <scluk/aliases.hpp>
+
+namespace batch {
+    using namespace scluk::type_aliases;
+
+    // fixed set of worker threads, each with its own task deque: a worker takes the newest task of its own deque
+    // (the one most likely to still be in its cache) and, when that is empty, steals the oldest task of another
+    // worker's deque. Tasks get the index of the worker running them, so that they can use per-worker state; they may
+    // submit more tasks, but must not throw. Meant for coarse tasks (files, chunks of files), so the deques are simply
+    // locked.
+    class work_stealing_pool {
+    public:
+        using task = std::function<void(u32 worker)>;
+    private:
+        struct worker_queue {
+            std::mutex m;
+            std::deque<task> tasks;
+        };
+        std::unique_ptr<worker_queue[]> queues;
+        u32 n_workers;
+        //tasks submitted and not finished yet; the workers leave when it gets to 0
+        std::atomic<u64> pending = 0;
+        std::atomic<u32> next_queue = 0;
+
+        bool try_pop(u32 worker, task& t) {
+            {
+                worker_queue& own = queues[worker];
+                std::lock_guard lock(own.m);
+                if(!own.tasks.empty()) {
+                    t = std::move(own.tasks.back());
+                    own.tasks.pop_back();
+                    return true;
+                }
+            }
+            for(u32 i = 1; i < n_workers; i++) {
+                worker_queue& victim = queues[(worker + i) % n_workers];
+                std::lock_guard lock(victim.m);
+                if(!victim.tasks.empty()) {
+                    t = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void work(u32 worker) {
+            task t;
+            while(pending.load(std::memory_order_acquire)) {
+                if(try_pop(worker, t)) {
+                    t(worker);
+                    t = nullptr;
+                    pending.fetch_sub(1, std::memory_order_acq_rel);
+                } else std::this_thread::yield();
+            }
+        }
+    public:
+        explicit work_stealing_pool(u32 workers = std::thread::hardware_concurrency())
+            : queues(new worker_queue[std::max(workers, 1u)]), n_workers(std::max(workers, 1u)) {}
+
+        u32 size() const { return n_workers; }
+
+        // queues t on the given worker's deque, or spreads the tasks round robin if worker is out of range; tasks
+        // submitted from inside a task should pass their own worker index
+        void submit(task t, u32 worker = ~0u) {
+            if(worker >= n_workers)
+                worker = next_queue.fetch_add(1, std::memory_order_relaxed) % n_workers;
+            pending.fetch_add(1, std::memory_order_acq_rel);
+            std::lock_guard lock(queues[worker].m);
+            queues[worker].tasks.push_back(std::move(t));
+        }
+
+        // runs every submitted task (and every task they submit) on the workers, and returns once they are all done;
+        // the calling thread is one of the workers
+        void run() {
+            std::vector<std::jthread> threads;
+            for(u32 w = 1; w < n_workers; w++)
+                threads.emplace_back(&work_stealing_pool::work, this, w);
+            work(0);
+        }
+    };
+}
+
+#endif //BATCH_WORK_STEALING_POOL_HPP
@@ -0,0 +1,381 @@
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <array>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <scluk/language_extension.hpp>
+#include <scluk/array.hpp>
+
+#include "../dft/sliding_dft.hpp"
+#include "../dft/sliding_dft_bank.hpp"
+#include "../dft/simd.hpp"
+#include "../dft/polar.hpp"
+#include "../phase_vocoder.hpp"
+#include "../pipelined_vocoder.hpp"
+#include "../harmonizer.hpp"
+#include "../any_vocoder.hpp"
+#include "../audio_params.hpp"
+
+namespace {
+    using namespace scluk::language_extension;
+    using namespace std::chrono_literals;
+    using clk = std::chrono::steady_clock;
+
+    volatile f32 sink;
+    std::atomic<u64> allocations = 0;
+}
+
+//count every allocation the program makes, to check that the hop pipeline doesn't make any once warmed up
+//(kept out of line, otherwise gcc sees malloc paired with delete and warns about a mismatch)
+[[gnu::noinline]] void* operator new(std::size_t sz) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(sz ? sz : 1)) return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+    //what to run and how, from the command line (see usage())
+    struct options {
+        //only the benchmarks whose name contains this
+        std::string filter;
+        //measurements of every benchmark; the median is reported, along with the fastest and the slowest
+        u32 repeat = 5;
+        std::chrono::milliseconds min_time = 200ms;
+        //where the results also go as csv, if anywhere ("-" for stdout)
+        std::string csv;
+    } opts;
+
+    const char* usage() {
+        return "usage: bench [--filter SUBSTRING] [--repeat N] [--min-time MS] [--csv FILE|-]\n"
+               "every benchmark measures a call (a hop, unless its name says otherwise) --repeat times for at least\n"
+               "--min-time each, and reports the median in ns and as x realtime at 48kHz: how many times over a core\n"
+               "could keep up with a stream producing what a call processes. --csv writes name,ns,min_ns,max_ns,frames,\n"
+               "x_realtime rows, to diff against the results of an earlier build on the same machine";
+    }
+
+    struct result {
+        std::string name;
+        f64 ns, min_ns, max_ns;
+        //frames of audio (of every channel) a call processes
+        f64 frames;
+        f64 x_realtime() const { return frames / 48000. * 1e9 / ns; }
+    };
+    std::vector<result> results;
+
+    //calls f repeatedly for at least min_time (after a short warm-up) and returns the average nanoseconds per call
+    template<typename F>
+    f64 ns_per_call(F&& f, std::chrono::nanoseconds min_time) {
+        for(u32 i : range(64)) { (void)i; f(); }
+
+        u64 calls = 0;
+        const auto start = clk::now();
+        auto now = start;
+        for(; now - start < min_time; now = clk::now())
+            for(u32 i : range(64)) { (void)i; f(); calls++; }
+
+        return f64(std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count()) / f64(calls);
+    }
+
+    //measures f as the benchmark name, unless the filter leaves it out. frames is the audio a call processes
+    template<typename F>
+    void bench(const std::string& name, f64 frames, F&& f) {
+        if(name.find(opts.filter) == std::string::npos) return;
+        std::vector<f64> ns;
+        for(u32 i : range(opts.repeat)) { (void)i; ns.push_back(ns_per_call(f, opts.min_time)); }
+        std::ranges::sort(ns);
+        const result& r = results.emplace_back(result { name, ns[ns.size() / 2], ns.front(), ns.back(), frames });
+
+        char line[200];
+        std::snprintf(line, sizeof(line), "%-44s %12.1f ns (%.1f - %.1f) %10.1f x realtime", r.name.c_str(), r.ns, r.min_ns,
+            r.max_ns, r.x_realtime());
+        out("%", line);
+    }
+
+    void write_csv(std::ostream& os) {
+        os << "name,ns,min_ns,max_ns,frames,x_realtime\n";
+        for(const result& r : results)
+            os << r.name << ',' << r.ns << ',' << r.min_ns << ',' << r.max_ns << ',' << r.frames << ',' << r.x_realtime() << '\n';
+    }
+
+    //a hop of a sine, the input of most benchmarks
+    template<typename C>
+    void fill_sine(C& chunk) {
+        for(u32 i : index(chunk))
+            chunk[i] = std::sin(f32(i) * 0.05f);
+    }
+
+    //the plain complex and real ffts, each standing for a hop of a window of the same size overlapped 4 times
+    template<u32 n>
+    void bench_fft(const std::string& kernels) {
+        constexpr f64 frames = n / 4;
+        std::vector<std::complex<f32>> x(n), spectrum(n/2 + 1);
+        std::vector<f32> real(n);
+        for(u32 i : range(n)) x[i] = real[i] = std::sin(f32(i) * 0.05f);
+
+        const dft::fft_plan<f32>& plan = dft::fft_plan<f32>::get(n);
+        const dft::real_fft_plan<f32>& real_plan = dft::real_fft_plan<f32>::get(n);
+        bench(sout("fft/forward/%/%", n, kernels), frames, [&] { plan.forward(x.data()); sink = x[1].real(); });
+        bench(sout("fft/inverse/%/%", n, kernels), frames, [&] { plan.inverse(x.data()); sink = x[1].real(); });
+        bench(sout("real_fft/forward/%/%", n, kernels), frames, [&] { real_plan.forward(real.data(), spectrum.data()); sink = spectrum[1].real(); });
+        bench(sout("real_fft/inverse/%/%", n, kernels), frames, [&] { real_plan.inverse(spectrum.data(), real.data()); sink = real[1]; });
+    }
+
+    template<u32 win, u32 overlap = 4>
+    void bench_sliding_dft(const std::string& kernels) {
+        constexpr u32 dist = win / overlap;
+        dft::sliding_dft<f32, win> dft;
+        scluk::heap_array<f32, dist> chunk;
+        fill_sine(chunk);
+
+        //one hop worth of frames, updated one at a time, as a block, and with a whole fft
+        bench(sout("sliding_dft/push_frame/%/%", win, kernels), dist, [&] { for(f32 frame : chunk) dft.push_frame(frame); });
+        bench(sout("sliding_dft/push_frames/%/%", win, kernels), dist, [&] { dft.push_frames(chunk); });
+        bench(sout("sliding_dft/push_frames_fft/%/%", win, kernels), dist, [&] { dft.push_frames_fft(chunk); });
+
+        std::array<u32, 32> bins;
+        for(u32 i : index(bins)) bins[i] = i * 4;
+        dft::sliding_dft_bank<f32, win> bank(bins);
+        bench(sout("sliding_dft_bank/push_frames/%x%/%", win, bins.size(), kernels), dist, [&] { bank.push_frames(chunk); });
+
+        //the pitch shifted ifft, at the transpositions the gui reaches; pitch factors below 1 need bigger transforms
+        typename dft::sliding_dft<f32, win>::ifft_workspace ws;
+        scluk::heap_array<f32, win> ift;
+        for(i32 semitones : { -12, -5, 0, 5, 12 })
+            bench(sout("dft_array/ifft/%/%st/%", win, semitones, kernels), dist, [&] {
+                dft.ifft(std::pow(2.f, f32(semitones) / 12.f), std::span<f32>(&ift[0], win), ws);
+                sink = ift[0];
+            });
+
+        //conversions of the whole spectrum to polar form and back, against the std::complex functions
+        constexpr u32 n_bins = win/2 + 1;
+        std::array<f32, n_bins> mag, phase, re, im;
+        bench(sout("polar/to_from/%/%", win, kernels), dist, [&] {
+            dft::to_polar(dft.real_data(), dft.imag_data(), mag.data(), phase.data(), n_bins);
+            dft::from_polar(mag.data(), phase.data(), re.data(), im.data(), n_bins);
+            sink = re[1];
+        });
+        bench(sout("polar/std_complex/%/%", win, kernels), dist, [&] {
+            for(u32 k : range(n_bins)) {
+                const std::complex<f32> c(dft.real_data()[k], dft.imag_data()[k]);
+                const std::complex<f32> p = std::polar(std::abs(c), std::arg(c));
+                re[k] = p.real();
+                im[k] = p.imag();
+            }
+            sink = re[1];
+        });
+    }
+
+    //throughput of the whole vocoder on a long signal fed in blocks of an awkward size, on a single core
+    template<u32 win, u32 overlap = 4>
+    void bench_vocoder(const std::string& kernels) {
+        phase_vocoder<win, overlap> vocoder;
+        vocoder.set_pitch_semitones(5.f);
+        std::vector<f32> in(1000), processed(in.size());
+        for(u32 i : index(in))
+            in[i] = std::sin(f32(i) * 0.05f) + 0.5f * std::sin(f32(i) * 0.31f);
+
+        bench(sout("phase_vocoder/process_1000_frames/%/%", win, kernels), f64(in.size()), [&] {
+            vocoder.process(in, processed);
+            sink = processed[0];
+        });
+    }
+
+    //a stereo stream with the three stages one after the other on a single thread, and pipelined across three
+    //threads (which only pays off with free cores for them)
+    template<u32 win, u32 overlap>
+    void bench_pipeline() {
+        using vocoder_t = multichannel_vocoder<win, overlap>;
+        //not in place: the output starts with a window of silence, which fed back in would be gated
+        std::vector<typename vocoder_t::hop_chunk> hops(2), outs(2);
+        fill_sine(hops[0]);
+        hops[1] = hops[0];
+
+        vocoder_t serial(2);
+        serial.set_pitch_semitones(5.f);
+        bench(sout("stereo_hop/serial/%/%", win, overlap), vocoder_t::hop_size, [&] { serial.process_hop(hops, outs); sink = outs[0][0]; });
+
+        vocoder_t staged(2);
+        staged.set_pitch_semitones(5.f);
+        pipelined_vocoder<win, overlap> pipeline(staged);
+        bench(sout("stereo_hop/pipelined/%/%", win, overlap), vocoder_t::hop_size, [&] { pipeline.process_hop(hops, outs); sink = outs[0][0]; });
+    }
+
+    //an eight channel hop processed, bypassed, and gated (silent input)
+    template<u32 win, u32 overlap>
+    void bench_fast_paths() {
+        using vocoder_t = multichannel_vocoder<win, overlap>;
+        std::vector<typename vocoder_t::hop_chunk> hops(8), silence(8), outs(8);
+        for(auto& h : hops) fill_sine(h);
+        for(auto& h : silence) h.fill(0.f);
+
+        vocoder_t v(8);
+        v.set_pitch_semitones(5.f);
+        bench(sout("8ch_hop/processed/%/%", win, overlap), vocoder_t::hop_size, [&] { v.process_hop(hops, outs); sink = outs[0][0]; });
+        v.set_bypass(true);
+        bench(sout("8ch_hop/bypassed/%/%", win, overlap), vocoder_t::hop_size, [&] { v.process_hop(hops, outs); sink = outs[0][0]; });
+        v.set_bypass(false);
+        bench(sout("8ch_hop/gated/%/%", win, overlap), vocoder_t::hop_size, [&] { v.process_hop(silence, outs); sink = outs[0][0]; });
+    }
+
+    //a three voice harmony of a mono stream: one harmonizer against a vocoder per voice, all on one thread
+    template<u32 win, u32 overlap>
+    void bench_harmonizer() {
+        using harmonizer_t = harmonizer<win, overlap>;
+        const std::array<harmony_voice, 3> voices {{ { 0.f, 1.f }, { 4.f, .7f }, { 7.f, .7f } }};
+        std::vector<typename harmonizer_t::hop_chunk> hops(1), outs(1);
+        fill_sine(hops[0]);
+
+        harmonizer_t h(1, voices);
+        bench(sout("harmony_hop/shared_analysis/%/%", win, overlap), harmonizer_t::hop_size, [&] { h.process_hop(hops, outs); sink = outs[0][0]; });
+
+        std::array<phase_vocoder<win, overlap>, voices.size()> separate;
+        for(u32 v : range(voices.size()))
+            separate[v].set_pitch_semitones(voices[v].semitones);
+        bench(sout("harmony_hop/vocoder_per_voice/%/%", win, overlap), harmonizer_t::hop_size, [&] {
+            for(auto& v : separate) v.process_hop(hops[0], outs[0]);
+            sink = outs[0][0];
+        });
+    }
+
+    //what the interactive mode does every hop, with a callback of a hop of frames in between: the callback moving the
+    //device buffers through the rings, the main loop taking the input out, processing it through the same runtime
+    //sized vocoder, handing it back and copying the spectrum for the gui (which it only does when the gui is ready
+    //for one, so this is the worst case)
+    void bench_main_loop(u32 win, u32 overlap, u16 channels) {
+        const std::unique_ptr<any_vocoder> vocoder = make_vocoder(win, overlap, channels,
+            channels == 2 ? channel_mode::mid_side : channel_mode::independent);
+        const u32 hop = vocoder->hop_size();
+        audio::duplex_ring ring(channels, hop);
+        std::vector<f32> device_in(hop * channels), device_out(hop * channels);
+        fill_sine(device_in);
+        std::vector<std::vector<f32>> frames(channels, std::vector<f32>(hop, 0.f));
+        std::vector<f32*> frame_ptrs;
+        for(std::vector<f32>& channel : frames) frame_ptrs.push_back(channel.data());
+        audio::spectrum_buffer gui_dft(vocoder->bins(), 0.f);
+        auto never = [] { return false; };
+
+        bench(sout("main_loop/%ch/%/%", channels, win, overlap), hop, [&] {
+            audio::cb(device_in.data(), device_out.data(), hop, (const PaStreamCallbackTimeInfo*)(nullptr), PaStreamCallbackFlags(0), &ring);
+            vocoder->set_window(dft::window_type::hann);
+            vocoder->set_pitch_factor(std::pow(2.f, 5.f/12.f));
+            vocoder->set_bypass(false);
+            ring.pop_input(frame_ptrs, never);
+            vocoder->process_hop(frame_ptrs, frame_ptrs);
+            ring.push_output(frame_ptrs, never);
+            vocoder->magnitudes(gui_dft);
+            sink = device_out[0];
+        });
+    }
+
+    //allocations made by the hop apis (analysis fft, pitch shifted ifft into a preallocated buffer) once every pitch
+    //factor the gui can select has been used once
+    template<u32 win, u32 overlap = 4>
+    u64 steady_state_allocations_per_hop() {
+        constexpr u32 dist = win / overlap;
+        dft::sliding_dft<f32, win> dft;
+        typename dft::sliding_dft<f32, win>::ifft_workspace ws;
+        scluk::heap_array<f32, win> ift;
+        std::array<f32, dist> chunk {};
+
+        auto hops = [&](u32 n) {
+            for(i32 semitones = -24; semitones <= 24; semitones++)
+                for(u32 i : range(n)) {
+                    (void)i;
+                    dft.push_frames_fft(chunk);
+                    dft.ifft(std::pow(2.f, f32(semitones)/12.f), std::span<f32>(&ift[0], win), ws);
+                }
+        };
+        hops(1);
+        const u64 before = allocations.load();
+        hops(20);
+        return (allocations.load() - before + 49 * 20 - 1) / (49 * 20);
+    }
+
+    //the same for the whole vocoder
+    template<u32 win, u32 overlap = 4>
+    u64 vocoder_steady_state_allocations() {
+        phase_vocoder<win, overlap> vocoder;
+        std::array<f32, 300> in {}, processed;
+        auto blocks = [&](u32 n) {
+            for(i32 semitones = -24; semitones <= 24; semitones++) {
+                vocoder.set_pitch_semitones(f32(semitones));
+                for(u32 i : range(n)) { (void)i; vocoder.process(in, processed); }
+            }
+        };
+        blocks(4);
+        const u64 before = allocations.load();
+        blocks(20);
+        return allocations.load() - before;
+    }
+}
+
+int main(int argc, char** argv) {
+    for(int i = 1; i < argc; i++) {
+        const std::string_view opt = argv[i];
+        if(opt == "-h" || opt == "--help" || i + 1 >= argc) {
+            out("%", usage());
+            return opt == "-h" || opt == "--help" ? 0 : 1;
+        }
+        const char* val = argv[++i];
+        if(opt == "--filter") opts.filter = val;
+        else if(opt == "--repeat") opts.repeat = std::max(u32(std::strtoul(val, nullptr, 10)), 1u);
+        else if(opt == "--min-time") opts.min_time = std::chrono::milliseconds(std::strtoul(val, nullptr, 10));
+        else if(opt == "--csv") opts.csv = val;
+        else {
+            out("unknown option: %\n%", opt, usage());
+            return 1;
+        }
+    }
+
+    const u64 allocs_1024 = steady_state_allocations_per_hop<1024>(), allocs_512 = steady_state_allocations_per_hop<512>();
+    out("steady state allocations per hop: % (ft_win=1024), % (ft_win=512)", allocs_1024, allocs_512);
+    const u64 vocoder_allocs = vocoder_steady_state_allocations<1024>();
+    out("phase_vocoder steady state allocations: %", vocoder_allocs);
+    if(allocs_1024 || allocs_512 || vocoder_allocs)
+        return 1;
+
+    for(const dft::simd::kernels_t* k : dft::simd::available_kernels()) {
+        dft::simd::use_kernels(*k);
+        bench_fft<256>(k->name);
+        bench_fft<1024>(k->name);
+        bench_fft<4096>(k->name);
+        bench_sliding_dft<1024>(k->name);
+        bench_sliding_dft<512>(k->name);
+        bench_vocoder<1024>(k->name);
+        bench_vocoder<512>(k->name);
+    }
+    //the rest with the kernels the program would pick
+    dft::simd::use_kernels(*dft::simd::available_kernels().front());
+    bench_pipeline<1024, 4>();
+    bench_pipeline<4096, 8>();
+    bench_harmonizer<1024, 4>();
+    bench_harmonizer<4096, 8>();
+    bench_fast_paths<1024, 4>();
+    bench_main_loop(1024, 4, 2);
+    bench_main_loop(4096, 8, 2);
+
+    if(opts.csv == "-")
+        write_csv(std::cout);
+    else if(!opts.csv.empty()) {
+        std::ofstream f(opts.csv);
+        write_csv(f);
+        if(!f) {
+            out("can't write %", opts.csv);
+            return 1;
+        }
+    }
+}
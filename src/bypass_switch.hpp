@@ -0,0 +1,119 @@
+#ifndef BYPASS_SWITCH_HPP
+#define BYPASS_SWITCH_HPP
+
+#include <array>
+#include <algorithm>
+#include <span>
+#include <vector>
+#include <scluk/aliases.hpp>
+#include "dft/unit_root.hpp"
+
+using namespace scluk::type_aliases;
+
+// the dry path of something that processes planar hops (the wet path), and the switching between the two: a delay
+// line as long as the latency of the wet path, and a crossfade over a hop whenever the bypass is switched, so that it
+// can be toggled without clicks. A wet path that stops while bypassed starts over when the bypass is lifted, and then
+// needs warm_hops hops (which play the delay line) before its output is whole again. Everything is allocated by the
+// constructor
+template<u32 hop_size>
+class bypass_switch {
+public:
+    using hop_chunk = std::array<f32, hop_size>;
+    //where the output of a hop comes from: the wet path, the delay line (dry) or a crossfade of the two. While
+    //warming up the wet path runs, from a clean state, but the delay line plays
+    enum class path : u8 { wet, to_dry, dry, warming, to_wet };
+private:
+    //raised cosine crossfade over a hop, whose two halves always sum to 1; the fade out is the fade in reversed
+    static constexpr std::array<f32, hop_size> fade_in = [] {
+        std::array<f32, hop_size> f {};
+        for(u32 i = 0; i < hop_size; i++) {
+            const long double s = dft::unit_root(2*i + 1, 8 * hop_size).imag();
+            f[i] = f32(s * s);
+        }
+        return f;
+    }();
+
+    u16 n_channels;
+    u32 delay_hops, warm_hops;
+    bool requested = false, restarting = false;
+    path state = path::wet;
+    u32 warmed = 0;
+    //the last delay_hops input hops of every channel (delay_hops in a row for each), as circular buffers at
+    //delay_pos, and the hop leaving them
+    std::vector<hop_chunk> delay;
+    u32 delay_pos = 0;
+    std::vector<hop_chunk> dry;
+public:
+    // delay_hops is the latency of the wet path in whole hops, on top of the one of re-blocking
+    bypass_switch(u16 channels, u32 delay_hops, u32 warm_hops)
+        : n_channels(channels), delay_hops(delay_hops), warm_hops(warm_hops), delay(channels * delay_hops), dry(channels) {
+        reset();
+    }
+
+    void set(bool b) { requested = b; }
+    bool is_set() const { return requested; }
+
+    void reset() {
+        for(hop_chunk& h : delay) h.fill(0.f);
+        for(hop_chunk& h : dry) h.fill(0.f);
+        delay_pos = 0;
+        restarting = false;
+        state = requested ? path::dry : path::wet;
+    }
+
+    // takes the input of a hop into the delay line and returns where the output of the hop comes from: the wet path
+    // has to process the hop unless it is dry
+    path begin_hop(std::span<const hop_chunk> in) {
+        restarting = false;
+        if(state == path::wet && requested) state = path::to_dry;
+        else if(state == path::warming && requested) state = path::dry;
+        else if(state == path::dry && !requested) {
+            restarting = true;
+            warmed = 0;
+            state = warm_hops ? path::warming : path::to_wet;
+        }
+
+        for(u16 c = 0; c < n_channels; c++) {
+            hop_chunk& slot = delay[c * delay_hops + delay_pos];
+            dry[c] = slot;
+            slot = in[c];
+        }
+        delay_pos = (delay_pos + 1) % delay_hops;
+        return state;
+    }
+    // whether the hop begun last is the first one out of the dry path, which a wet path that stops starts over from
+    bool restarts() const { return restarting; }
+
+    // turns the output of the wet path for the hop begun last, in out, into the output of the hop; out need not hold
+    // anything if the hop is dry
+    void end_hop(std::span<hop_chunk> out) {
+        switch(state) {
+            case path::dry:
+                std::copy(dry.begin(), dry.end(), out.begin());
+                break;
+            case path::to_dry:
+                crossfade(out, dry, out);
+                state = path::dry;
+                break;
+            case path::warming:
+                std::copy(dry.begin(), dry.end(), out.begin());
+                if(++warmed == warm_hops) state = path::to_wet;
+                break;
+            case path::to_wet:
+                crossfade(dry, out, out);
+                state = path::wet;
+                break;
+            default: break;
+        }
+    }
+
+private:
+    //out = from faded out + to faded in, where out may be the same memory as either
+    void crossfade(std::span<const hop_chunk> from, std::span<const hop_chunk> to, std::span<hop_chunk> out) {
+        for(u16 c = 0; c < n_channels; c++)
+            for(u32 i = 0; i < hop_size; i++)
+                out[c][i] = from[c][i] * fade_in[hop_size - 1 - i] + to[c][i] * fade_in[i];
+    }
+};
+
+#endif //BYPASS_SWITCH_HPP
@@ -1,62 +1,399 @@
 #ifndef dft_FFT_HPP
+#define dft_FFT_HPP
 
 #include <complex>
-#include <iostream>
 #include <valarray>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <bit>
 #include <cassert>
+#include <cmath>
 
 #include <scluk/math.hpp>
 #include <scluk/aliases.hpp>
- 
+#include "simd.hpp"
+#include "unit_root.hpp"
+
 namespace dft {
+    using namespace scluk::type_aliases;
+
     namespace detail {
+        //plain complex multiplication; std::complex's operator* calls __mulsc3 to handle infinities unless -ffast-math is on
         template<typename T>
-        void in_place_fft(std::valarray<std::complex<T>>& x) {
-            using namespace scluk::math_literals;
-            using namespace scluk::type_aliases;
-            using std::complex, std::valarray;
-
-            const std::size_t N = x.size();
-            if (N <= 1) return;
-            assert(std::has_single_bit(N) && "the size of the valarray passed to fft must be a power of two");
-        
-            // divide
-            valarray<complex<T>> even = x[std::slice(0, N/2, 2)];
-            valarray<complex<T>>  odd = x[std::slice(1, N/2, 2)];
-        
-            // conquer
-            in_place_fft(even);
-            in_place_fft(odd);
-        
-            // combine
-            for (size_t k = 0; k < N/2; k++) {
-                complex<T> t = std::polar(T(1.), - T(2_pi) * k / N) * odd[k];
-                x[k    ] = even[k] + t;
-                x[k+N/2] = even[k] - t;
+        inline std::complex<T> mul(std::complex<T> a, std::complex<T> b) {
+            return { a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real() };
+        }
+    }
+
+    // iterative mixed radix (2, 3, 5) Cooley–Tukey FFT of a fixed size; sizes with other prime factors fall back on
+    // Bluestein's chirp-z algorithm, which turns the transform into a convolution computed with a power of two FFT.
+    // All the twiddles and the digit reversal permutation are computed once when the plan is built, so running it
+    // does no transcendental calls and no allocations (other than growing a per-thread scratch buffer the first time
+    // a size is used on a thread). f32 power of two plans run their butterflies on split real/imaginary arrays through
+    // the simd kernels.
+    template<std::floating_point T>
+    class fft_plan {
+        struct stage_t {
+            u32 radix;
+            //size of the sub-transforms this stage combines
+            u32 span;
+            std::size_t twiddle_offset;
+        };
+
+        std::size_t n;
+        std::vector<stage_t> stages;
+        //pairs of indices to swap (in order) to digit-reverse the input
+        std::vector<std::pair<u32, u32>> swaps;
+        //e^(-i*2pi*j*k/(span*radix)) for k in [0, span), j in [1, radix), for each stage; stored one stage after the other
+        std::vector<std::complex<T>> twiddles;
+
+        //only used by bluestein plans: e^(-i*pi*k^2/n), the fft of its conjugate, and the power of two plan for the convolution
+        std::vector<std::complex<T>> chirp, chirp_spectrum;
+        std::unique_ptr<fft_plan> conv;
+
+        //only used by split plans: gather[p] is the input element that goes to position p, and the twiddles split in two
+        std::vector<u32> gather;
+        std::vector<f32> twiddles_re, twiddles_im;
+        static constexpr std::size_t min_split_size = 16;
+
+        //e^(-i*2pi*num/den)
+        static std::complex<T> root(u64 num, u64 den) {
+            return std::complex<T>(std::conj(unit_root(num, den)));
+        }
+
+        template<bool inverse>
+        void mixed_radix(std::complex<T>* x) const {
+            using detail::mul;
+            using cpx = std::complex<T>;
+            //multiplies by -i (or by i for the inverse transform)
+            auto rot = [](cpx z) -> cpx { return inverse ? cpx(-z.imag(), z.real()) : cpx(z.imag(), -z.real()); };
+
+            for(auto [a, b] : swaps)
+                std::swap(x[a], x[b]);
+
+            for(const stage_t& st : stages) {
+                const std::size_t L = st.span, block = L * st.radix;
+                const cpx* w = twiddles.data() + st.twiddle_offset;
+
+                switch(st.radix) {
+                case 2:
+                    for(std::size_t b = 0; b < n; b += block)
+                        for(std::size_t k = 0; k < L; k++) {
+                            const cpx t = mul(inverse ? std::conj(w[k]) : w[k], x[b+k+L]);
+                            x[b+k+L] = x[b+k] - t;
+                            x[b+k] += t;
+                        }
+                    break;
+                case 3: {
+                    const T s = T(0.866025403784438646763723170752936183l); //sin(2pi/3)
+                    for(std::size_t b = 0; b < n; b += block)
+                        for(std::size_t k = 0; k < L; k++) {
+                            const cpx* wk = w + 2*k;
+                            const cpx a0 = x[b+k];
+                            const cpx a1 = mul(inverse ? std::conj(wk[0]) : wk[0], x[b+k+L]);
+                            const cpx a2 = mul(inverse ? std::conj(wk[1]) : wk[1], x[b+k+2*L]);
+                            const cpx t1 = a1 + a2, t2 = a0 - t1 * T(.5), t3 = rot(a1 - a2) * s;
+                            x[b+k] = a0 + t1;
+                            x[b+k+L] = t2 + t3;
+                            x[b+k+2*L] = t2 - t3;
+                        }
+                    break;
+                }
+                case 5: {
+                    const T c1 = T( 0.309016994374947424102293417182819059l), s1 = T(0.951056516295153572116439333379382143l); //2pi/5
+                    const T c2 = T(-0.809016994374947424102293417182819059l), s2 = T(0.587785252292473129168705954639072769l); //4pi/5
+                    for(std::size_t b = 0; b < n; b += block)
+                        for(std::size_t k = 0; k < L; k++) {
+                            const cpx* wk = w + 4*k;
+                            cpx a[5] = { x[b+k] };
+                            for(u32 j = 1; j < 5; j++)
+                                a[j] = mul(inverse ? std::conj(wk[j-1]) : wk[j-1], x[b+k+j*L]);
+
+                            const cpx b1 = a[1] + a[4], b2 = a[2] + a[3], d1 = a[1] - a[4], d2 = a[2] - a[3];
+                            const cpx r1 = a[0] + b1 * c1 + b2 * c2, r2 = a[0] + b1 * c2 + b2 * c1;
+                            const cpx i1 = rot(d1 * s1 + d2 * s2), i2 = rot(d1 * s2 - d2 * s1);
+                            x[b+k] = a[0] + b1 + b2;
+                            x[b+k+L] = r1 + i1;
+                            x[b+k+2*L] = r2 + i2;
+                            x[b+k+3*L] = r2 - i2;
+                            x[b+k+4*L] = r1 - i1;
+                        }
+                    break;
+                }
+                }
             }
         }
 
-        template<typename T>
-        void in_place_ifft(std::valarray<std::complex<T>>& x) {
-            x = x.apply(std::conj);// conjugate the complex numbers
-            detail::in_place_fft(x);// forward fft
-            x = x.apply(std::conj);// conjugate the complex numbers again
-            x /= x.size();// scale the numbers
+        template<bool inverse>
+        void split_radix2(std::complex<T>* x) const {
+            if constexpr(std::same_as<T, f32>) {
+                thread_local std::vector<f32> re, im;
+                if(re.size() < n) {
+                    re.resize(n);
+                    im.resize(n);
+                }
+
+                for(std::size_t p = 0; p < n; p++) {
+                    re[p] = x[gather[p]].real();
+                    im[p] = x[gather[p]].imag();
+                }
+                const simd::kernels_t& k = simd::kernels();
+                for(const stage_t& st : stages)
+                    k.radix2_stage(re.data(), im.data(), twiddles_re.data() + st.twiddle_offset, twiddles_im.data() + st.twiddle_offset, n, st.span, inverse);
+                for(std::size_t p = 0; p < n; p++)
+                    x[p] = { re[p], im[p] };
+            }
         }
+
+        //forward transform only; the inverse is obtained by conjugating input and output
+        void bluestein(std::complex<T>* x) const {
+            using detail::mul;
+            const std::size_t m = conv->size();
+            thread_local std::vector<std::complex<T>> scratch;
+            if(scratch.size() < m) scratch.resize(m);
+
+            for(std::size_t k = 0; k < n; k++)
+                scratch[k] = mul(x[k], chirp[k]);
+            std::fill(scratch.begin() + std::ptrdiff_t(n), scratch.begin() + std::ptrdiff_t(m), std::complex<T>(0));
+
+            conv->forward(scratch.data());
+            for(std::size_t k = 0; k < m; k++)
+                scratch[k] = mul(scratch[k], chirp_spectrum[k]);
+            conv->inverse(scratch.data());
+
+            for(std::size_t k = 0; k < n; k++)
+                x[k] = mul(scratch[k], chirp[k]);
+        }
+    public:
+        explicit fft_plan(std::size_t n) : n(n) {
+            assert(n > 0 && "an fft_plan cannot have size 0");
+
+            std::vector<u32> factors;
+            std::size_t rest = n;
+            for(u32 radix : { 2, 3, 5 })
+                for(; rest % radix == 0; rest /= radix)
+                    factors.push_back(radix);
+
+            if(rest != 1) {
+                //bluestein: X[k] = c[k] * sum_j (x[j]*c[j]) * conj(c[k-j]), with c[k] = e^(-i*pi*k^2/n)
+                conv = std::make_unique<fft_plan>(std::bit_ceil(2*n - 1));
+                const std::size_t m = conv->size();
+
+                chirp.resize(n);
+                for(std::size_t k = 0; k < n; k++)
+                    chirp[k] = root(u64(k) * u64(k), 2*n);
+
+                chirp_spectrum.assign(m, std::complex<T>(0));
+                chirp_spectrum[0] = std::conj(chirp[0]);
+                for(std::size_t k = 1; k < n; k++)
+                    chirp_spectrum[k] = chirp_spectrum[m-k] = std::conj(chirp[k]);
+                conv->forward(chirp_spectrum.data());
+                return;
+            }
+
+            //stage i combines sub-transforms of size factors[0] * ... * factors[i-1]
+            std::size_t span = 1;
+            for(u32 radix : factors) {
+                stages.push_back({ radix, u32(span), twiddles.size() });
+                for(std::size_t k = 0; k < span; k++)
+                    for(u32 j = 1; j < radix; j++)
+                        twiddles.push_back(root(j*k, span*radix));
+                span *= radix;
+            }
+
+            //the element at position p after the permutation is the input element at digit_reversed(p)
+            auto digit_reversed = [&](std::size_t p) {
+                std::size_t ret = 0, m = n, weight = 1;
+                for(auto it = factors.rbegin(); it != factors.rend(); ++it) {
+                    m /= *it;
+                    ret += weight * (p / m);
+                    p %= m;
+                    weight *= *it;
+                }
+                return ret;
+            };
+            if(std::same_as<T, f32> && std::has_single_bit(n) && n >= min_split_size) {
+                gather.resize(n);
+                for(std::size_t p = 0; p < n; p++)
+                    gather[p] = u32(digit_reversed(p));
+                for(const std::complex<T>& w : twiddles) {
+                    twiddles_re.push_back(f32(w.real()));
+                    twiddles_im.push_back(f32(w.imag()));
+                }
+                return;
+            }
+
+            //turn the permutation into a sequence of swaps by applying it to a list of indices
+            std::vector<u32> at(n), where(n);
+            for(u32 i = 0; i < n; i++) at[i] = where[i] = i;
+            for(u32 p = 0; p < n; p++) {
+                const u32 src = where[digit_reversed(p)];
+                if(src == p) continue;
+                swaps.emplace_back(p, src);
+                std::swap(at[p], at[src]);
+                where[at[p]] = p;
+                where[at[src]] = src;
+            }
+        }
+
+        std::size_t size() const { return n; }
+
+        void forward(std::complex<T>* x) const {
+            if(!gather.empty()) split_radix2<false>(x);
+            else if(conv) bluestein(x);
+            else mixed_radix<false>(x);
+        }
+        //inverse transform, scaled by 1/n
+        void inverse(std::complex<T>* x) const {
+            const T scale = T(1) / T(n);
+            if(conv) {
+                for(std::size_t i = 0; i < n; i++) x[i] = std::conj(x[i]);
+                bluestein(x);
+                for(std::size_t i = 0; i < n; i++) x[i] = std::conj(x[i]) * scale;
+            } else {
+                if(!gather.empty()) split_radix2<true>(x);
+                else mixed_radix<true>(x);
+                for(std::size_t i = 0; i < n; i++) x[i] *= scale;
+            }
+        }
+
+        //plans are built on first request and shared by every thread for the rest of the program
+        static const fft_plan& get(std::size_t n) {
+            static std::mutex mtx;
+            static std::map<std::size_t, std::unique_ptr<fft_plan>> cache;
+
+            std::lock_guard lock(mtx);
+            std::unique_ptr<fft_plan>& plan = cache[n];
+            if(!plan) plan = std::make_unique<fft_plan>(n);
+            return *plan;
+        }
+    };
+
+    // the size closest to x with no prime factors but 2, 3 and 5, i.e. one fft_plan transforms without Bluestein
+    inline u64 nearest_smooth_size(f64 x) {
+        u64 best = 1;
+        for(u64 p2 = 1; f64(p2) < 2. * x; p2 *= 2)
+            for(u64 p3 = p2; f64(p3) < 2. * x; p3 *= 3)
+                for(u64 p5 = p3; f64(p5) < 2. * x; p5 *= 5)
+                    if(std::abs(f64(p5) - x) < std::abs(f64(best) - x)) best = p5;
+        return best;
     }
 
-    // Cooley–Tukey FFT (in-place, divide-and-conquer)
+    // FFT of real input of size n. Only the n/2+1 non-redundant bins are produced (or consumed, for the inverse).
+    // For even sizes the input is packed into n/2 complex numbers, transformed with an n/2 point complex FFT, and the
+    // even and odd halves are then untangled with one extra pass ("post-twist"); odd sizes go through a full size
+    // complex FFT.
+    template<std::floating_point T>
+    class real_fft_plan {
+        std::size_t n;
+        const fft_plan<T>& half;
+        //e^(-i*2pi*k/n) for k in [0, n/4]
+        std::vector<std::complex<T>> twiddles;
+
+        static std::vector<std::complex<T>>& odd_scratch(std::size_t n) {
+            thread_local std::vector<std::complex<T>> scratch;
+            if(scratch.size() < n) scratch.resize(n);
+            return scratch;
+        }
+    public:
+        explicit real_fft_plan(std::size_t n) : n(n), half(fft_plan<T>::get(n % 2 ? n : n/2)), twiddles(n/4 + 1) {
+            assert(n > 0 && "a real_fft_plan cannot have size 0");
+
+            for(std::size_t k = 0; k < twiddles.size(); k++)
+                twiddles[k] = std::complex<T>(std::conj(unit_root(k, n)));
+        }
+
+        std::size_t size() const { return n; }
+        std::size_t bins() const { return n/2 + 1; }
+
+        //in has n elements, out has n/2+1
+        void forward(const T* in, std::complex<T>* out) const {
+            using detail::mul;
+            if(n % 2) {
+                std::vector<std::complex<T>>& z = odd_scratch(n);
+                std::copy(in, in + n, z.begin());
+                half.forward(z.data());
+                std::copy(z.begin(), z.begin() + std::ptrdiff_t(bins()), out);
+                return;
+            }
+
+            const std::size_t m = n/2;
+            for(std::size_t k = 0; k < m; k++)
+                out[k] = { in[2*k], in[2*k+1] };
+
+            half.forward(out);
+
+            const std::complex<T> z0 = out[0];
+            out[0] = { z0.real() + z0.imag(), T(0) };
+            out[m] = { z0.real() - z0.imag(), T(0) };
+            //X[k] = E[k] + W^k*O[k], and X[m-k] = conj(E[k] - W^k*O[k])
+            for(std::size_t k = 1; k <= m/2; k++) {
+                const std::complex<T> a = out[k], b = std::conj(out[m-k]);
+                const std::complex<T> even = (a + b) * T(.5);
+                const std::complex<T> odd = mul(a - b, std::complex<T>(0, -.5));
+                const std::complex<T> t = mul(twiddles[k], odd);
+                out[k] = even + t;
+                out[m-k] = std::conj(even - t);
+            }
+        }
+
+        //in has n/2+1 elements and is left untouched, out has n elements; scaled by 1/n
+        void inverse(const std::complex<T>* in, T* out) const {
+            using detail::mul;
+            if(n % 2) {
+                std::vector<std::complex<T>>& z = odd_scratch(n);
+                z[0] = in[0];
+                for(std::size_t k = 1; k < bins(); k++) {
+                    z[k] = in[k];
+                    z[n-k] = std::conj(in[k]);
+                }
+                half.inverse(z.data());
+                for(std::size_t i = 0; i < n; i++)
+                    out[i] = z[i].real();
+                return;
+            }
+
+            const std::size_t m = n/2;
+            //the output buffer is used as the n/2 complex numbers the half size transform works on
+            std::complex<T>* z = reinterpret_cast<std::complex<T>*>(out);
+
+            z[0] = std::complex<T>(in[0].real() + in[m].real(), in[0].real() - in[m].real()) * T(.5);
+            for(std::size_t k = 1; k <= m/2; k++) {
+                const std::complex<T> a = in[k], b = std::conj(in[m-k]);
+                const std::complex<T> even = (a + b) * T(.5);
+                const std::complex<T> odd = mul(a - b, std::conj(twiddles[k])) * T(.5);
+                //Z[k] = E[k] + i*O[k], and Z[m-k] = conj(E[k]) + i*conj(O[k])
+                z[k] = even + std::complex<T>(-odd.imag(), odd.real());
+                z[m-k] = std::conj(even) + std::complex<T>(odd.imag(), odd.real());
+            }
+
+            half.inverse(z);
+        }
+
+        static const real_fft_plan& get(std::size_t n) {
+            static std::mutex mtx;
+            static std::map<std::size_t, std::unique_ptr<real_fft_plan>> cache;
+
+            std::lock_guard lock(mtx);
+            std::unique_ptr<real_fft_plan>& plan = cache[n];
+            if(!plan) plan = std::make_unique<real_fft_plan>(n);
+            return *plan;
+        }
+    };
+
+    // Cooley–Tukey FFT
     template<typename T>
     std::valarray<std::complex<T>> fft(std::valarray<std::complex<T>> x) {
-        detail::in_place_fft(x);
+        fft_plan<T>::get(x.size()).forward(std::begin(x));
         return x;
     }
 
-    // inverse fft (in-place)
+    // inverse fft
     template<typename T>
     std::valarray<std::complex<T>> ifft(std::valarray<std::complex<T>> x) {
-        detail::in_place_ifft(x);
+        fft_plan<T>::get(x.size()).inverse(std::begin(x));
         return x;
     }
 }
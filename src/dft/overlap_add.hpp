@@ -0,0 +1,61 @@
+#ifndef dft_OVERLAP_ADD_HPP
+#define dft_OVERLAP_ADD_HPP
+
+#include <array>
+#include <algorithm>
+#include <concepts>
+#include <scluk/aliases.hpp>
+#include <scluk/array.hpp>
+
+namespace dft {
+    using namespace scluk::type_aliases;
+
+    // overlap-add accumulator for frames of N samples placed every N/overlap samples: a circular buffer of N partial
+    // sums, where each frame is added in place starting at the oldest unfinished sample and every emit() hands out
+    // (and clears) the hop of samples no future frame can touch anymore. The memory it touches per hop is one frame
+    // plus one hop, whatever the overlap factor; all the loops are over contiguous ranges so they vectorize.
+    template<std::floating_point T, u32 N, u32 overlap>
+    class overlap_add {
+    public:
+        static constexpr u32 frame_size = N;
+        static constexpr u32 hop_size = N / overlap;
+        static_assert(N % overlap == 0, "the frame size must be a multiple of the overlap factor");
+    private:
+        scluk::heap_array<T, N> acc;
+        //index in acc of the first sample of the next hop to emit; always a multiple of hop_size
+        u32 head = 0;
+
+        static void add_range(T* __restrict dst, const T* __restrict frame, const T* __restrict window, T gain, u32 n) {
+            for(u32 i = 0; i < n; i++)
+                dst[i] += frame[i] * window[i] * gain;
+        }
+    public:
+        overlap_add() : acc(T(0)) {}
+
+        void reset() {
+            std::fill(acc.begin(), acc.end(), T(0));
+            head = 0;
+        }
+
+        // adds frame[i] * window[i] * gain to the accumulator, frame[0] landing on the first sample of the next hop
+        void add(const T* frame, const T* window, T gain = T(1)) {
+            const u32 first = N - head;
+            add_range(&acc[head], frame, window, gain, first);
+            add_range(&acc[0], frame + first, window + first, gain, head);
+        }
+        void add(const std::array<T, N>& frame, const std::array<T, N>& window, T gain = T(1)) {
+            add(frame.data(), window.data(), gain);
+        }
+
+        // writes the next hop_size finished samples to out and starts accumulating a new hop in their place
+        void emit(T* out) {
+            T* hop = &acc[head];
+            std::copy(hop, hop + hop_size, out);
+            std::fill(hop, hop + hop_size, T(0));
+            head = (head + hop_size) % N;
+        }
+        void emit(std::array<T, hop_size>& out) { emit(out.data()); }
+    };
+}
+
+#endif //dft_OVERLAP_ADD_HPP
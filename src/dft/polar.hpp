@@ -0,0 +1,45 @@
+#ifndef dft_POLAR_HPP
+#define dft_POLAR_HPP
+
+#include <cmath>
+#include <complex>
+#include <concepts>
+#include <type_traits>
+#include <scluk/aliases.hpp>
+#include <scluk/math.hpp>
+#include "simd.hpp"
+
+// conversions between the rectangular and polar forms of whole spectra held as split arrays; f32 goes through the
+// fast approximations of the simd kernels (see simd.hpp for their error bounds), other types through the std library
+namespace dft {
+    using namespace scluk::type_aliases;
+
+    template<std::floating_point T>
+    void to_polar(const T* re, const T* im, T* mag, T* phase, std::size_t n) {
+        if constexpr(std::is_same_v<T, f32>)
+            simd::kernels().to_polar(re, im, mag, phase, n);
+        else for(std::size_t i = 0; i < n; i++) {
+            mag[i] = std::hypot(re[i], im[i]);
+            phase[i] = std::atan2(im[i], re[i]);
+        }
+    }
+
+    template<std::floating_point T>
+    void from_polar(const T* mag, const T* phase, T* re, T* im, std::size_t n) {
+        if constexpr(std::is_same_v<T, f32>)
+            simd::kernels().from_polar(mag, phase, re, im, n);
+        else for(std::size_t i = 0; i < n; i++) {
+            re[i] = mag[i] * std::cos(phase[i]);
+            im[i] = mag[i] * std::sin(phase[i]);
+        }
+    }
+
+    //the same angle in [-pi, pi]
+    template<std::floating_point T>
+    T wrap_phase(T p) {
+        using namespace scluk::math::literals;
+        return p - T(2_pi_l) * std::nearbyint(p * T(1 / 2_pi_l));
+    }
+}
+
+#endif //dft_POLAR_HPP
@@ -0,0 +1,371 @@
+#include "simd.hpp"
+#include <atomic>
+#include <array>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DFT_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace dft::simd {
+    //coefficients of the polar/rectangular approximations; the functions doing the range reduction opt out of
+    //-fassociative-math (part of -Ofast), which would otherwise fold the three parts of pi/2 back together
+    namespace approx {
+        constexpr f32 pi = 3.14159265358979f, half_pi = 1.57079632679490f, two_over_pi = 0.636619772367581f;
+        //pi/2 split in three parts with few significant bits, so that x - j*pi/2 stays accurate for large j (cephes)
+        constexpr f32 half_pi_1 = 1.5703125f, half_pi_2 = 4.837512969970703125e-4f, half_pi_3 = 7.54978995489188216e-8f;
+        //minimax atan(a)/a on [0, 1] as a polynomial in a^2
+        constexpr f32 atan_c[] = { 0.99997726f, -0.33262347f, 0.19354346f, -0.11643287f, 0.05265332f, -0.01172120f };
+        //sin(r) = r + r^3*p(r^2), cos(r) = 1 - r^2/2 + r^4*q(r^2) on [-pi/4, pi/4] (cephes)
+        constexpr f32 sin_c[] = { -1.6666654611e-1f, 8.3321608736e-3f, -1.9515295891e-4f };
+        constexpr f32 cos_c[] = { 4.166664568298827e-2f, -1.388731625493765e-3f, 2.443315711809948e-5f };
+    }
+
+    namespace scalar {
+        void radix2_stage(f32* re, f32* im, const f32* w_re, const f32* w_im, std::size_t n, std::size_t span, bool inverse) {
+            const f32 sign = inverse ? -1.f : 1.f;
+            for(std::size_t b = 0; b < n; b += 2*span) {
+                f32* ar = re + b, * ai = im + b, * br = re + b + span, * bi = im + b + span;
+                for(std::size_t k = 0; k < span; k++) {
+                    const f32 wr = w_re[k], wi = sign * w_im[k];
+                    const f32 tr = wr * br[k] - wi * bi[k], ti = wr * bi[k] + wi * br[k];
+                    br[k] = ar[k] - tr;
+                    bi[k] = ai[k] - ti;
+                    ar[k] += tr;
+                    ai[k] += ti;
+                }
+            }
+        }
+
+        void sliding_dft_update(f32* re, f32* im, const f32* w_re, const f32* w_im, std::size_t bins, const f32* deltas, std::size_t n_deltas, f32 damping) {
+            //several bins at a time, otherwise every step waits for the previous one to finish
+            constexpr std::size_t lanes = 8;
+            for(std::size_t k = 0; k < bins; k += lanes) {
+                const std::size_t l_count = std::min(lanes, bins - k);
+                f32 r[lanes], i[lanes];
+                for(std::size_t l = 0; l < l_count; l++) {
+                    r[l] = re[k+l];
+                    i[l] = im[k+l];
+                }
+                for(std::size_t d = 0; d < n_deltas; d++)
+                    for(std::size_t l = 0; l < l_count; l++) {
+                        const f32 a = r[l] * damping + deltas[d], b = i[l] * damping;
+                        r[l] = a * w_re[k+l] - b * w_im[k+l];
+                        i[l] = a * w_im[k+l] + b * w_re[k+l];
+                    }
+                for(std::size_t l = 0; l < l_count; l++) {
+                    re[k+l] = r[l];
+                    im[k+l] = i[l];
+                }
+            }
+        }
+
+        f32 atan2(f32 y, f32 x) {
+            using namespace approx;
+            const f32 ax = std::abs(x), ay = std::abs(y);
+            const f32 mx = std::max(ax, ay), mn = std::min(ax, ay);
+            const f32 a = mx > 0.f ? mn / mx : 0.f, s = a*a;
+            f32 r = a * (atan_c[0] + s*(atan_c[1] + s*(atan_c[2] + s*(atan_c[3] + s*(atan_c[4] + s*atan_c[5])))));
+            if(ay > ax) r = half_pi - r;
+            if(x < 0.f) r = pi - r;
+            return std::copysign(r, y);
+        }
+
+        [[gnu::optimize("no-associative-math")]]
+        void sincos(f32 x, f32& sin, f32& cos) {
+            using namespace approx;
+            const f32 j = std::nearbyint(x * two_over_pi);
+            const f32 r = ((x - j*half_pi_1) - j*half_pi_2) - j*half_pi_3, r2 = r*r;
+            const f32 sr = r + r*r2*(sin_c[0] + r2*(sin_c[1] + r2*sin_c[2]));
+            const f32 cr = 1.f - .5f*r2 + r2*r2*(cos_c[0] + r2*(cos_c[1] + r2*cos_c[2]));
+            //which quadrant x was in
+            switch(i32(j) & 3) {
+                case 0: sin = sr;  cos = cr;  break;
+                case 1: sin = cr;  cos = -sr; break;
+                case 2: sin = -sr; cos = -cr; break;
+                default: sin = -cr; cos = sr;  break;
+            }
+        }
+
+        void to_polar(const f32* re, const f32* im, f32* mag, f32* phase, std::size_t n) {
+            for(std::size_t i = 0; i < n; i++) {
+                mag[i] = std::sqrt(re[i]*re[i] + im[i]*im[i]);
+                phase[i] = atan2(im[i], re[i]);
+            }
+        }
+
+        void from_polar(const f32* mag, const f32* phase, f32* re, f32* im, std::size_t n) {
+            for(std::size_t i = 0; i < n; i++) {
+                f32 s, c;
+                sincos(phase[i], s, c);
+                re[i] = mag[i] * c;
+                im[i] = mag[i] * s;
+            }
+        }
+
+        constexpr kernels_t kernels = { "scalar", radix2_stage, sliding_dft_update, to_polar, from_polar };
+    }
+
+    #ifdef DFT_SIMD_X86
+    //sse2 is part of x86-64, so this set needs no detection
+    namespace sse {
+        void radix2_stage(f32* re, f32* im, const f32* w_re, const f32* w_im, std::size_t n, std::size_t span, bool inverse) {
+            if(span < 4) return scalar::radix2_stage(re, im, w_re, w_im, n, span, inverse);
+
+            const __m128 sign = _mm_set1_ps(inverse ? -1.f : 1.f);
+            for(std::size_t b = 0; b < n; b += 2*span) {
+                f32* ar = re + b, * ai = im + b, * br = re + b + span, * bi = im + b + span;
+                for(std::size_t k = 0; k < span; k += 4) {
+                    const __m128 wr = _mm_loadu_ps(w_re + k), wi = _mm_mul_ps(sign, _mm_loadu_ps(w_im + k));
+                    const __m128 xr = _mm_loadu_ps(br + k), xi = _mm_loadu_ps(bi + k);
+                    const __m128 tr = _mm_sub_ps(_mm_mul_ps(wr, xr), _mm_mul_ps(wi, xi));
+                    const __m128 ti = _mm_add_ps(_mm_mul_ps(wr, xi), _mm_mul_ps(wi, xr));
+                    const __m128 yr = _mm_loadu_ps(ar + k), yi = _mm_loadu_ps(ai + k);
+                    _mm_storeu_ps(br + k, _mm_sub_ps(yr, tr));
+                    _mm_storeu_ps(bi + k, _mm_sub_ps(yi, ti));
+                    _mm_storeu_ps(ar + k, _mm_add_ps(yr, tr));
+                    _mm_storeu_ps(ai + k, _mm_add_ps(yi, ti));
+                }
+            }
+        }
+
+        void sliding_dft_update(f32* re, f32* im, const f32* w_re, const f32* w_im, std::size_t bins, const f32* deltas, std::size_t n_deltas, f32 damping) {
+            const __m128 damp = _mm_set1_ps(damping);
+            std::size_t k = 0;
+            //two vectors at a time, so that the two dependency chains can overlap
+            for(; k + 8 <= bins; k += 8) {
+                __m128 r0 = _mm_loadu_ps(re + k), i0 = _mm_loadu_ps(im + k), r1 = _mm_loadu_ps(re + k + 4), i1 = _mm_loadu_ps(im + k + 4);
+                const __m128 wr0 = _mm_loadu_ps(w_re + k), wi0 = _mm_loadu_ps(w_im + k);
+                const __m128 wr1 = _mm_loadu_ps(w_re + k + 4), wi1 = _mm_loadu_ps(w_im + k + 4);
+                for(std::size_t d = 0; d < n_deltas; d++) {
+                    const __m128 delta = _mm_set1_ps(deltas[d]);
+                    const __m128 a0 = _mm_add_ps(_mm_mul_ps(r0, damp), delta), b0 = _mm_mul_ps(i0, damp);
+                    const __m128 a1 = _mm_add_ps(_mm_mul_ps(r1, damp), delta), b1 = _mm_mul_ps(i1, damp);
+                    r0 = _mm_sub_ps(_mm_mul_ps(a0, wr0), _mm_mul_ps(b0, wi0));
+                    i0 = _mm_add_ps(_mm_mul_ps(a0, wi0), _mm_mul_ps(b0, wr0));
+                    r1 = _mm_sub_ps(_mm_mul_ps(a1, wr1), _mm_mul_ps(b1, wi1));
+                    i1 = _mm_add_ps(_mm_mul_ps(a1, wi1), _mm_mul_ps(b1, wr1));
+                }
+                _mm_storeu_ps(re + k, r0);
+                _mm_storeu_ps(im + k, i0);
+                _mm_storeu_ps(re + k + 4, r1);
+                _mm_storeu_ps(im + k + 4, i1);
+            }
+            scalar::sliding_dft_update(re + k, im + k, w_re + k, w_im + k, bins - k, deltas, n_deltas, damping);
+        }
+
+        //mask ? a : b
+        inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+            return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+        }
+
+        void to_polar(const f32* re, const f32* im, f32* mag, f32* phase, std::size_t n) {
+            using namespace approx;
+            const __m128 sign_bit = _mm_set1_ps(-0.f), tiny = _mm_set1_ps(1e-37f), zero = _mm_setzero_ps();
+            std::size_t i = 0;
+            for(; i + 4 <= n; i += 4) {
+                const __m128 x = _mm_loadu_ps(re + i), y = _mm_loadu_ps(im + i);
+                _mm_storeu_ps(mag + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))));
+
+                const __m128 ax = _mm_andnot_ps(sign_bit, x), ay = _mm_andnot_ps(sign_bit, y);
+                const __m128 a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), tiny)), s = _mm_mul_ps(a, a);
+                __m128 r = _mm_set1_ps(atan_c[5]);
+                for(i32 c = 4; c >= 0; c--)
+                    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(atan_c[c]));
+                r = _mm_mul_ps(r, a);
+                r = select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(half_pi), r), r);
+                r = select(_mm_cmplt_ps(x, zero), _mm_sub_ps(_mm_set1_ps(pi), r), r);
+                _mm_storeu_ps(phase + i, _mm_or_ps(r, _mm_and_ps(sign_bit, y)));
+            }
+            scalar::to_polar(re + i, im + i, mag + i, phase + i, n - i);
+        }
+
+        [[gnu::optimize("no-associative-math")]]
+        void from_polar(const f32* mag, const f32* phase, f32* re, f32* im, std::size_t n) {
+            using namespace approx;
+            const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+            std::size_t i = 0;
+            for(; i + 4 <= n; i += 4) {
+                const __m128 x = _mm_loadu_ps(phase + i);
+                const __m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(two_over_pi)));
+                const __m128 j = _mm_cvtepi32_ps(q);
+                __m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(half_pi_1)));
+                r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(half_pi_2)));
+                r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(half_pi_3)));
+                const __m128 r2 = _mm_mul_ps(r, r);
+
+                __m128 sp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(sin_c[2]), r2), _mm_set1_ps(sin_c[1]));
+                sp = _mm_add_ps(_mm_mul_ps(sp, r2), _mm_set1_ps(sin_c[0]));
+                const __m128 sr = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sp));
+                __m128 cp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(cos_c[2]), r2), _mm_set1_ps(cos_c[1]));
+                cp = _mm_add_ps(_mm_mul_ps(cp, r2), _mm_set1_ps(cos_c[0]));
+                const __m128 cr = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(_mm_set1_ps(.5f), r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), cp));
+
+                //odd quadrants swap sin and cos, and bit 1 of q (of q+1 for cos) flips the sign
+                const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one));
+                const __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, two), 30));
+                const __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, one), two), 30));
+                const __m128 s = _mm_xor_ps(select(swap, cr, sr), sin_sign), c = _mm_xor_ps(select(swap, sr, cr), cos_sign);
+
+                const __m128 m = _mm_loadu_ps(mag + i);
+                _mm_storeu_ps(re + i, _mm_mul_ps(m, c));
+                _mm_storeu_ps(im + i, _mm_mul_ps(m, s));
+            }
+            scalar::from_polar(mag + i, phase + i, re + i, im + i, n - i);
+        }
+
+        constexpr kernels_t kernels = { "sse2", radix2_stage, sliding_dft_update, to_polar, from_polar };
+    }
+
+    namespace avx2 {
+        [[gnu::target("avx2,fma")]]
+        void radix2_stage(f32* re, f32* im, const f32* w_re, const f32* w_im, std::size_t n, std::size_t span, bool inverse) {
+            if(span < 8) return sse::radix2_stage(re, im, w_re, w_im, n, span, inverse);
+
+            const __m256 sign = _mm256_set1_ps(inverse ? -1.f : 1.f);
+            for(std::size_t b = 0; b < n; b += 2*span) {
+                f32* ar = re + b, * ai = im + b, * br = re + b + span, * bi = im + b + span;
+                for(std::size_t k = 0; k < span; k += 8) {
+                    const __m256 wr = _mm256_loadu_ps(w_re + k), wi = _mm256_mul_ps(sign, _mm256_loadu_ps(w_im + k));
+                    const __m256 xr = _mm256_loadu_ps(br + k), xi = _mm256_loadu_ps(bi + k);
+                    const __m256 tr = _mm256_fmsub_ps(wr, xr, _mm256_mul_ps(wi, xi));
+                    const __m256 ti = _mm256_fmadd_ps(wr, xi, _mm256_mul_ps(wi, xr));
+                    const __m256 yr = _mm256_loadu_ps(ar + k), yi = _mm256_loadu_ps(ai + k);
+                    _mm256_storeu_ps(br + k, _mm256_sub_ps(yr, tr));
+                    _mm256_storeu_ps(bi + k, _mm256_sub_ps(yi, ti));
+                    _mm256_storeu_ps(ar + k, _mm256_add_ps(yr, tr));
+                    _mm256_storeu_ps(ai + k, _mm256_add_ps(yi, ti));
+                }
+            }
+        }
+
+        [[gnu::target("avx2,fma")]]
+        void sliding_dft_update(f32* re, f32* im, const f32* w_re, const f32* w_im, std::size_t bins, const f32* deltas, std::size_t n_deltas, f32 damping) {
+            const __m256 damp = _mm256_set1_ps(damping);
+            std::size_t k = 0;
+            //two vectors at a time, so that the two dependency chains can overlap
+            for(; k + 16 <= bins; k += 16) {
+                __m256 r0 = _mm256_loadu_ps(re + k), i0 = _mm256_loadu_ps(im + k), r1 = _mm256_loadu_ps(re + k + 8), i1 = _mm256_loadu_ps(im + k + 8);
+                const __m256 wr0 = _mm256_loadu_ps(w_re + k), wi0 = _mm256_loadu_ps(w_im + k);
+                const __m256 wr1 = _mm256_loadu_ps(w_re + k + 8), wi1 = _mm256_loadu_ps(w_im + k + 8);
+                for(std::size_t d = 0; d < n_deltas; d++) {
+                    const __m256 delta = _mm256_set1_ps(deltas[d]);
+                    const __m256 a0 = _mm256_fmadd_ps(r0, damp, delta), b0 = _mm256_mul_ps(i0, damp);
+                    const __m256 a1 = _mm256_fmadd_ps(r1, damp, delta), b1 = _mm256_mul_ps(i1, damp);
+                    r0 = _mm256_fmsub_ps(a0, wr0, _mm256_mul_ps(b0, wi0));
+                    i0 = _mm256_fmadd_ps(a0, wi0, _mm256_mul_ps(b0, wr0));
+                    r1 = _mm256_fmsub_ps(a1, wr1, _mm256_mul_ps(b1, wi1));
+                    i1 = _mm256_fmadd_ps(a1, wi1, _mm256_mul_ps(b1, wr1));
+                }
+                _mm256_storeu_ps(re + k, r0);
+                _mm256_storeu_ps(im + k, i0);
+                _mm256_storeu_ps(re + k + 8, r1);
+                _mm256_storeu_ps(im + k + 8, i1);
+            }
+            sse::sliding_dft_update(re + k, im + k, w_re + k, w_im + k, bins - k, deltas, n_deltas, damping);
+        }
+
+        [[gnu::target("avx2,fma")]]
+        void to_polar(const f32* re, const f32* im, f32* mag, f32* phase, std::size_t n) {
+            using namespace approx;
+            const __m256 sign_bit = _mm256_set1_ps(-0.f), tiny = _mm256_set1_ps(1e-37f), zero = _mm256_setzero_ps();
+            std::size_t i = 0;
+            for(; i + 8 <= n; i += 8) {
+                const __m256 x = _mm256_loadu_ps(re + i), y = _mm256_loadu_ps(im + i);
+                _mm256_storeu_ps(mag + i, _mm256_sqrt_ps(_mm256_fmadd_ps(x, x, _mm256_mul_ps(y, y))));
+
+                const __m256 ax = _mm256_andnot_ps(sign_bit, x), ay = _mm256_andnot_ps(sign_bit, y);
+                const __m256 a = _mm256_div_ps(_mm256_min_ps(ax, ay), _mm256_max_ps(_mm256_max_ps(ax, ay), tiny)), s = _mm256_mul_ps(a, a);
+                __m256 r = _mm256_set1_ps(atan_c[5]);
+                for(i32 c = 4; c >= 0; c--)
+                    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(atan_c[c]));
+                r = _mm256_mul_ps(r, a);
+                r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(half_pi), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+                r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(pi), r), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+                _mm256_storeu_ps(phase + i, _mm256_or_ps(r, _mm256_and_ps(sign_bit, y)));
+            }
+            sse::to_polar(re + i, im + i, mag + i, phase + i, n - i);
+        }
+
+        [[gnu::target("avx2,fma"), gnu::optimize("no-associative-math")]]
+        void from_polar(const f32* mag, const f32* phase, f32* re, f32* im, std::size_t n) {
+            using namespace approx;
+            const __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2);
+            std::size_t i = 0;
+            for(; i + 8 <= n; i += 8) {
+                const __m256 x = _mm256_loadu_ps(phase + i);
+                const __m256 j = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(two_over_pi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                const __m256i q = _mm256_cvtps_epi32(j);
+                __m256 r = _mm256_fnmadd_ps(j, _mm256_set1_ps(half_pi_1), x);
+                r = _mm256_fnmadd_ps(j, _mm256_set1_ps(half_pi_2), r);
+                r = _mm256_fnmadd_ps(j, _mm256_set1_ps(half_pi_3), r);
+                const __m256 r2 = _mm256_mul_ps(r, r);
+
+                __m256 sp = _mm256_fmadd_ps(_mm256_set1_ps(sin_c[2]), r2, _mm256_set1_ps(sin_c[1]));
+                sp = _mm256_fmadd_ps(sp, r2, _mm256_set1_ps(sin_c[0]));
+                const __m256 sr = _mm256_fmadd_ps(_mm256_mul_ps(r, r2), sp, r);
+                __m256 cp = _mm256_fmadd_ps(_mm256_set1_ps(cos_c[2]), r2, _mm256_set1_ps(cos_c[1]));
+                cp = _mm256_fmadd_ps(cp, r2, _mm256_set1_ps(cos_c[0]));
+                const __m256 cr = _mm256_fmadd_ps(_mm256_mul_ps(r2, r2), cp, _mm256_fnmadd_ps(_mm256_set1_ps(.5f), r2, _mm256_set1_ps(1.f)));
+
+                //odd quadrants swap sin and cos, and bit 1 of q (of q+1 for cos) flips the sign
+                const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, one), one));
+                const __m256 sin_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, two), 30));
+                const __m256 cos_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, one), two), 30));
+                const __m256 s = _mm256_xor_ps(_mm256_blendv_ps(sr, cr, swap), sin_sign);
+                const __m256 c = _mm256_xor_ps(_mm256_blendv_ps(cr, sr, swap), cos_sign);
+
+                const __m256 m = _mm256_loadu_ps(mag + i);
+                _mm256_storeu_ps(re + i, _mm256_mul_ps(m, c));
+                _mm256_storeu_ps(im + i, _mm256_mul_ps(m, s));
+            }
+            sse::from_polar(mag + i, phase + i, re + i, im + i, n - i);
+        }
+
+        constexpr kernels_t kernels = { "avx2", radix2_stage, sliding_dft_update, to_polar, from_polar };
+    }
+    #endif
+
+    namespace {
+        struct kernel_list {
+            std::array<const kernels_t*, 3> arr;
+            std::size_t sz = 0;
+
+            kernel_list() {
+                arr[sz++] = &scalar::kernels;
+                #ifdef DFT_SIMD_X86
+                arr[sz++] = &sse::kernels;
+                __builtin_cpu_init();
+                if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+                    arr[sz++] = &avx2::kernels;
+                #endif
+            }
+        };
+
+        const kernel_list& list() {
+            static const kernel_list l;
+            return l;
+        }
+
+        std::atomic<const kernels_t*> active = nullptr;
+    }
+
+    const kernels_t& kernels() {
+        const kernels_t* k = active.load(std::memory_order_relaxed);
+        if(!k) {
+            k = list().arr[list().sz - 1];
+            active.store(k, std::memory_order_relaxed);
+        }
+        return *k;
+    }
+
+    std::span<const kernels_t* const> available_kernels() {
+        return { list().arr.data(), list().sz };
+    }
+
+    void use_kernels(const kernels_t& k) {
+        active.store(&k, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef dft_SIMD_HPP
+#define dft_SIMD_HPP
+
+#include <cstddef>
+#include <span>
+#include <scluk/aliases.hpp>
+
+// Hand vectorized f32 kernels for the hot loops of the dft code. Every kernel set has the same interface; the best one
+// the cpu supports is picked the first time kernels() is called, so a single binary runs on any x86-64 (or non x86)
+// machine. All the kernels work on split ("structure of arrays") data: real and imaginary parts in separate arrays.
+namespace dft::simd {
+    using namespace scluk::type_aliases;
+
+    struct kernels_t {
+        const char* name;
+
+        // one radix-2 decimation in time stage over n elements: for every block of 2*span elements and k in [0, span)
+        // (a, b) = (x[k], x[k+span]) becomes (a + w[k]*b, a - w[k]*b), with w conjugated if inverse is true
+        void (*radix2_stage)(f32* re, f32* im, const f32* w_re, const f32* w_im, std::size_t n, std::size_t span, bool inverse);
+
+        // sliding dft update of the first bins elements for every delta (new frame - frame leaving the window) in
+        // order: x[k] = (x[k] * damping + delta) * w[k]; each group of bins goes through all the deltas while it is
+        // held in registers
+        void (*sliding_dft_update)(f32* re, f32* im, const f32* w_re, const f32* w_im, std::size_t bins, const f32* deltas, std::size_t n_deltas, f32 damping);
+
+        // magnitude and phase of n complex numbers. The phase is a polynomial atan2 approximation in [-pi, pi] (0 for
+        // 0+0i) with an absolute error below 2e-6 radians, i.e. phase noise ~-110dB below the signal. The magnitude is
+        // sqrt(re^2 + im^2), exact to a couple of ulps as long as the squares don't overflow
+        void (*to_polar)(const f32* re, const f32* im, f32* mag, f32* phase, std::size_t n);
+
+        // the inverse of to_polar: re = mag*cos(phase), im = mag*sin(phase). sin and cos are computed together after
+        // reducing the phase to [-pi/4, pi/4]; the absolute error is below 2e-7 for |phase| < 1e4 and grows with
+        // |phase| after that, so keep phases wrapped
+        void (*from_polar)(const f32* mag, const f32* phase, f32* re, f32* im, std::size_t n);
+    };
+
+    const kernels_t& kernels();
+    // every kernel set this cpu can run, the best one last
+    std::span<const kernels_t* const> available_kernels();
+    // overrides the automatic choice (mainly for benchmarks); k must be one of available_kernels()
+    void use_kernels(const kernels_t& k);
+}
+
+#endif //dft_SIMD_HPP
@@ -10,49 +10,99 @@
 #include <type_traits>
 #include <utility>
 #include <concepts>
+#include <span>
+#include <vector>
 #include <scluk/sliding_queue.hpp>
 #include <scluk/language_extension.hpp>
 #include <scluk/math.hpp>
 #include <scluk/array.hpp>
 #include <scluk/metaprogramming.hpp>
 #include "fft.hpp"
+#include "simd.hpp"
+#include "window.hpp"
+#include "unit_root.hpp"
 
 namespace dft {
     using namespace scluk::language_extension;
     using scluk::heap_array, scluk::sliding_queue;
 
+    //spectrum of N real frames; only the N/2+1 non-redundant bins are stored, the rest are their complex conjugates
     template <std::floating_point T, size_t N> 
-    struct dft_array : public heap_array<std::complex<T>, N> {
+    struct dft_array : public heap_array<std::complex<T>, N/2 + 1> {
         static constexpr size_t sz = N;
+        static constexpr size_t bins = N/2 + 1;
         constexpr T get_frequency_per_frame(u32 i) const    		{ return T(i) / T(N); }
         constexpr T get_frames_per_period(u32 i) const      		{ return T(N) / T(i); }
         constexpr T get_frequency_hz(u32 i, u32 rate) const 		{ return get_frequency_per_frame(i) * T(rate); }
         constexpr T get_seconds_per_period(u32 i, u32 rate) const	{ return get_frames_per_period(i) / T(rate); }
 
-        dft_array() : heap_array<std::complex<T>, N>() {}
-        dft_array(dft_array&& o) : heap_array<std::complex<T>, N>(std::move(o)) {}
-        dft_array(dft_array& o) : heap_array<std::complex<T>, N>(o) {}
+        dft_array() : heap_array<std::complex<T>, bins>() {}
+        dft_array(dft_array&& o) : heap_array<std::complex<T>, bins>(std::move(o)) {}
+        dft_array(dft_array& o) : heap_array<std::complex<T>, bins>(o) {}
 
+        std::complex<T>* data() { return &(*this)[0]; }
+        const std::complex<T>* data() const { return &(*this)[0]; }
 
-        template<u64 ret_len>
-        heap_array<T, ret_len> ifft(f32 pitch_factor) {
-            heap_array<T, ret_len> ret;
-            const u64 n_of_hrms = u64(f32(N) / pitch_factor); // also equal to the number of frames in a period
-            const u64 hrms_to_be_copied = std::min(N, n_of_hrms);
+        //the period, in frames, of what ifft writes at pitch_factor: N/pitch_factor, moved to the nearest size with no
+        //prime factors but 2, 3 and 5 when that detunes it by less than about 4 cents (the gaps between such sizes are
+        //too wide to always round). The periods left over, like 1366 frames for N = 1024 at -5 semitones, go through
+        //Bluestein, whose ifft takes roughly ten times as long as a smooth one of about the same size
+        static u64 period(f32 pitch_factor) {
+            const f64 exact = f64(N) / f64(pitch_factor);
+            const u64 smooth = nearest_smooth_size(exact);
+            return std::abs(f64(smooth) - exact) < exact * .0025 ? smooth : u64(exact);
+        }
+
+        //builds the plan ifft needs at pitch_factor, if it hasn't been already, so that a thread about to run ifft at
+        //that pitch only has to look it up
+        static void prepare_ifft(f32 pitch_factor) { real_fft_plan<T>::get(period(pitch_factor)); }
+
+        //the plan and scratch buffers ifft uses at a pitch factor; they are looked up (under a lock) and resized again
+        //only when the pitch changes, and the buffers only grow, so once they have seen the largest pitch factor ifft
+        //does not allocate
+        struct ifft_workspace {
+            f32 pitch_factor = 0.f;
+            u64 n = 0;
+            const real_fft_plan<T>* plan = nullptr;
+            std::vector<std::complex<T>> harmonics;
+            std::vector<T> frames;
+
+            void prepare(f32 f) {
+                if(plan && f == pitch_factor) return;
+                pitch_factor = f;
+                n = period(f);
+                plan = &real_fft_plan<T>::get(n);
+                harmonics.resize(n/2 + 1);
+                frames.resize(n);
+            }
+        };
 
-            std::valarray<std::complex<T>> harmonics(std::complex<T>(0.), n_of_hrms);
+        //writes to out the signal this spectrum describes with its pitch multiplied by pitch_factor, repeated as needed.
+        //The harmonics are those of a real signal (each stands for itself and its mirror image), and keep the amplitude
+        //they have at pitch 1 at any pitch: an inverse over a period of n frames would scale them by N/n otherwise
+        void ifft(f32 pitch_factor, std::span<T> out, ifft_workspace& ws) const {
+            ws.prepare(pitch_factor);
+            const u64 n_of_hrms = ws.n; // also equal to the number of frames in a period
+            const u64 hrms_to_be_copied = std::min(bins, n_of_hrms/2 + 1);
+            const T gain = T(n_of_hrms) / T(N);
 
-            std::copy(this->begin(), this->begin() + hrms_to_be_copied, std::begin(harmonics));
-            std::valarray<std::complex<T>> c_frames = dft::ifft(std::move(harmonics));
+            for(u64 k = 0; k < hrms_to_be_copied; k++)
+                ws.harmonics[k] = (*this)[k] * gain;
+            std::fill(ws.harmonics.begin() + i64(hrms_to_be_copied), ws.harmonics.end(), std::complex<T>(0.));
 
-            std::valarray<T> frames(c_frames.size());
-            for(u32 i : index(frames)) frames[i] = c_frames[i].real();
+            ws.plan->inverse(ws.harmonics.data(), ws.frames.data());
 
-            for(u64 written_frames = 0; written_frames < ret_len; written_frames += frames.size()) {
-                u64 to_copy = std::min(frames.size(), ret_len - written_frames);
-                std::copy(std::begin(frames), std::begin(frames)+to_copy, ret.begin()+written_frames);
+            for(u64 written_frames = 0; written_frames < out.size(); written_frames += n_of_hrms) {
+                u64 to_copy = std::min(n_of_hrms, out.size() - written_frames);
+                std::copy(ws.frames.begin(), ws.frames.begin() + i64(to_copy), out.begin() + i64(written_frames));
             }
+        }
 
+        template<u64 ret_len>
+        heap_array<T, ret_len> ifft(f32 pitch_factor) const {
+            heap_array<T, ret_len> ret;
+            ifft_workspace ws;
+            ifft(pitch_factor, std::span<T>(&ret[0], ret_len), ws);
             return ret;
         }
         dft_array& operator=(dft_array&& o) { 
@@ -76,65 +126,141 @@ namespace dft {
         }
     };
 
+    namespace detail {
+        //X[k] = (X[k] * damping + delta) * w[k] for every delta in order; each bin goes through all the deltas before
+        //moving to the next one, so it stays in registers
+        template<std::floating_point T>
+        void sliding_dft_update(T* re, T* im, const T* w_re, const T* w_im, std::size_t bins, const T* deltas, std::size_t n_deltas, T damping) {
+            if constexpr(std::same_as<T, f32>) {
+                simd::kernels().sliding_dft_update(re, im, w_re, w_im, bins, deltas, n_deltas, damping);
+            } else {
+                for(std::size_t k = 0; k < bins; k++) {
+                    T r = re[k], i = im[k];
+                    for(std::size_t d = 0; d < n_deltas; d++) {
+                        const T a = r * damping + deltas[d], b = i * damping;
+                        r = a * w_re[k] - b * w_im[k];
+                        i = a * w_im[k] + b * w_re[k];
+                    }
+                    re[k] = r;
+                    im[k] = i;
+                }
+            }
+        }
+    }
+
     template<std::floating_point T, u32 N, scluk::concepts::ratio damping_ratio = std::ratio<0, 1>>
     class sliding_dft : public dft_array<T, N> {
-        static bool static_attributes_are_inited;
-        static std::array<std::complex<T>, N> harmonic_phase;
+        static constexpr T damping_factor = T(damping_ratio::den - damping_ratio::num) / T(damping_ratio::den);
+        //how many frames push_frames applies to the bins in a single pass
+        static constexpr u32 block_size = 64;
+
+        //e^(i*2pi*k/N), what every bin k is rotated by at each frame; computed at compile time, so there is nothing to
+        //initialize when the first instance is created, on whatever thread
+        static constexpr std::array<std::array<T, dft_array<T, N>::bins>, 2> harmonic_phase = unit_roots<T, N, dft_array<T, N>::bins>();
 
-        sliding_queue<std::complex<T>, N> queue;
+        sliding_queue<T, N> queue;
+        const real_fft_plan<T>& plan = real_fft_plan<T>::get(N);
+        //windowed copy of the queue, the input of the fft
+        heap_array<T, N> staging;
+        window_type window = window_type::hann;
+        //the state of the sliding dft, split in real and imaginary parts so that the updates can be vectorized;
+        //the complex array this class inherits from is a copy kept up to date after every push
+        heap_array<T, dft_array<T, N>::bins> re, im;
+
+        void update(const T* deltas, std::size_t n_deltas) {
+            detail::sliding_dft_update(&re[0], &im[0], harmonic_phase[0].data(), harmonic_phase[1].data(), bins, deltas, n_deltas, damping_factor);
+        }
+        void store_bins() {
+            for(u32 k : range(bins))
+                (*this)[k] = { re[k], im[k] };
+        }
+        void load_bins() {
+            for(u32 k : range(bins)) {
+                re[k] = (*this)[k].real();
+                im[k] = (*this)[k].imag();
+            }
+        }
     public:
         using harmonic_array_t = dft_array<T, N>;
+        using dft_array<T, N>::bins;
         static constexpr u32 window_size = N;
 
-        sliding_dft() : queue(0) {
-            using namespace scluk::math::literals;
-            if(!static_attributes_are_inited) {
-                for(u32 k : index(*this))
-                    harmonic_phase[k] = std::exp(std::complex<T>(0., T(2_pi_l) * T(k) / T(N)));
-                static_attributes_are_inited = true;
-            }
+        sliding_dft() : queue(0), re(T(0)), im(T(0)) {
+            store_bins();
         }
         
         void reset() {
             for(auto& frame : queue)
                 frame = 0;
-            for(auto& harmonic : *this)
-                harmonic = 0;
+            for(u32 k : range(bins))
+                re[k] = im[k] = 0;
+            store_bins();
         }
 
-        void push_frame(std::complex<T> new_frame) {
-            static constexpr T damping_factor = T(damping_ratio::den - damping_ratio::num) / T(damping_ratio::den);
-            const std::complex<T> old_frame = queue.push(new_frame);
-            const std::complex<T> delta = (new_frame - old_frame);
+        void push_frame(T new_frame) {
+            const T old_frame = queue.push(new_frame);
+            const T delta = (new_frame - old_frame);
             //fourier shift theorem:
             //  N is the sliding window size;
             //  f(t) is the input at time t;
             //  F(k,t) is the value at frequency k and time t
             //  F(k, t) = e^(i*2pi*k/N)*F(k, t-1)*(f(t)*f(t-N))
-            for(u32 k : index(*this))
-                (*this)[k] = ((*this)[k] * damping_factor + delta) * harmonic_phase[k];
+            update(&delta, 1);
+            store_bins();
         }
-        void push_frame(T new_frame) { push_frame(std::complex<T>(new_frame, 0.)); }
 
+        //same result as calling push_frame for each frame, but the frames are applied in blocks, each in a single
+        //pass over the bins
         template<scluk::concepts::iterable iterable_t>
         void push_frames(const iterable_t& frames) {
-            for(auto frame : frames)
-                push_frame(frame);
+            std::array<T, block_size> deltas;
+            u32 n_deltas = 0;
+            for(T frame : frames) {
+                deltas[n_deltas++] = frame - queue.push(frame);
+                if(n_deltas == block_size) {
+                    update(deltas.data(), n_deltas);
+                    n_deltas = 0;
+                }
+            }
+            update(deltas.data(), n_deltas);
+            store_bins();
         }
 
+        //the same spectrum as the inherited array, split in real and imaginary parts
+        const T* real_data() const { return &re[0]; }
+        const T* imag_data() const { return &im[0]; }
+
+        //window applied to the input by push_frames_fft (the sliding updates are never windowed)
+        void set_window(window_type t) { window = t; }
+        window_type get_window() const { return window; }
+
         template<scluk::concepts::iterable iterable_t>
         void push_frames_fft(const iterable_t& frames) {
+            enqueue_frames(frames);
+            transform();
+        }
+
+        //only slides the frames into the window, leaving the spectrum as it was until the next transform()
+        template<scluk::concepts::iterable iterable_t>
+        void enqueue_frames(const iterable_t& frames) {
             for(const auto& frame : frames) queue.push(frame);
+        }
 
-            std::valarray<std::complex<T>> in(queue.size());
-            std::copy(std::begin(queue), std::end(queue), std::begin(in));
+        //windowed fft of the frames in the window
+        void transform() {
+            //the window is applied while copying the queue into the fft input
+            const std::array<T, N>& coeffs = window_table<T, N>(window);
+            u32 i = 0;
+            for(T frame : queue) {
+                staging[i] = frame * coeffs[i];
+                i++;
+            }
 
-            std::valarray<std::complex<T>> out = fft(scluk::math::hann_window(std::move(in)));
-            std::copy(std::begin(out), std::end(out), this->begin());
+            plan.forward(&staging[0], this->data());
+            load_bins();
         }
     };
 }
 
-#include "sliding_dft.tpp"
 
 #endif //dft_SLIDING_DFT_HPP
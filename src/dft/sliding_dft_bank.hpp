@@ -0,0 +1,98 @@
+#ifndef dft_SLIDING_DFT_BANK_HPP
+#define dft_SLIDING_DFT_BANK_HPP
+
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <cmath>
+#include "sliding_dft.hpp"
+
+namespace dft {
+    // a sliding_dft that only tracks a chosen set of bins (a bank of Goertzel-like resonators sharing one sliding
+    // window): same window semantics, damping and results for the tracked bins, but the cost of each pushed frame
+    // scales with the number of tracked bins instead of N
+    template<std::floating_point T, u32 N, scluk::concepts::ratio damping_ratio = std::ratio<0, 1>>
+    class sliding_dft_bank {
+        static constexpr T damping_factor = T(damping_ratio::den - damping_ratio::num) / T(damping_ratio::den);
+        static constexpr u32 block_size = 64;
+
+        sliding_queue<T, N> queue;
+        std::vector<u32> bin_indices;
+        //state and harmonic phase of the tracked bins, split in real and imaginary parts like in sliding_dft
+        std::vector<T> re, im, w_re, w_im;
+
+        void update(const T* deltas, std::size_t n_deltas) {
+            detail::sliding_dft_update(re.data(), im.data(), w_re.data(), w_im.data(), size(), deltas, n_deltas, damping_factor);
+        }
+    public:
+        static constexpr u32 window_size = N;
+        static constexpr u32 max_bin = N/2;
+
+        //tracks the given bins (indices in the spectrum of a sliding_dft<T, N>); duplicates are ignored
+        explicit sliding_dft_bank(std::span<const u32> bins) : queue(0), bin_indices(bins.begin(), bins.end()) {
+            using namespace scluk::math::literals;
+            std::sort(bin_indices.begin(), bin_indices.end());
+            bin_indices.erase(std::unique(bin_indices.begin(), bin_indices.end()), bin_indices.end());
+            if(!bin_indices.empty() && bin_indices.back() > max_bin)
+                throw std::out_of_range("sliding_dft_bank: bin index out of range");
+
+            re.assign(size(), T(0));
+            im.assign(size(), T(0));
+            for(u32 k : bin_indices) {
+                const std::complex<T> phase = std::exp(std::complex<T>(0., T(2_pi_l) * T(k) / T(N)));
+                w_re.push_back(phase.real());
+                w_im.push_back(phase.imag());
+            }
+        }
+
+        //tracks every bin whose centre frequency falls in one of the [low, high] ranges (in Hz)
+        static sliding_dft_bank from_hz_ranges(u32 rate, std::span<const std::pair<f32, f32>> ranges) {
+            std::vector<u32> bins;
+            for(auto [low, high] : ranges) {
+                const f32 first = std::ceil(std::max(low, 0.f) * f32(N) / f32(rate));
+                const f32 last = std::floor(std::min(high * f32(N) / f32(rate), f32(max_bin)));
+                for(f32 k = first; k <= last; k++)
+                    bins.push_back(u32(k));
+            }
+            return sliding_dft_bank(bins);
+        }
+
+        void reset() {
+            for(auto& frame : queue)
+                frame = 0;
+            std::fill(re.begin(), re.end(), T(0));
+            std::fill(im.begin(), im.end(), T(0));
+        }
+
+        void push_frame(T new_frame) {
+            const T delta = new_frame - queue.push(new_frame);
+            update(&delta, 1);
+        }
+
+        template<scluk::concepts::iterable iterable_t>
+        void push_frames(const iterable_t& frames) {
+            std::array<T, block_size> deltas;
+            u32 n_deltas = 0;
+            for(T frame : frames) {
+                deltas[n_deltas++] = frame - queue.push(frame);
+                if(n_deltas == block_size) {
+                    update(deltas.data(), n_deltas);
+                    n_deltas = 0;
+                }
+            }
+            update(deltas.data(), n_deltas);
+        }
+
+        //number of tracked bins
+        std::size_t size() const { return bin_indices.size(); }
+        //spectrum index of the i-th tracked bin
+        u32 bin(std::size_t i) const { return bin_indices[i]; }
+        std::span<const u32> bins() const { return bin_indices; }
+        //value of the i-th tracked bin
+        std::complex<T> operator[](std::size_t i) const { return { re[i], im[i] }; }
+
+        T get_frequency_hz(std::size_t i, u32 rate) const { return T(bin_indices[i]) / T(N) * T(rate); }
+    };
+}
+
+#endif //dft_SLIDING_DFT_BANK_HPP
@@ -0,0 +1,72 @@
+#ifndef dft_UNIT_ROOT_HPP
+#define dft_UNIT_ROOT_HPP
+
+#include <array>
+#include <complex>
+#include <concepts>
+#include <scluk/aliases.hpp>
+
+namespace dft {
+    using namespace scluk::type_aliases;
+
+    namespace detail {
+        //taylor series of sin and cos, for |x| <= pi/4, where they converge in a dozen terms
+        constexpr long double sin_series(long double x) {
+            long double term = x, sum = x;
+            for(u32 n = 1; n < 16 && term != 0; n++) {
+                term *= -x * x / ((long double)(2*n) * (long double)(2*n + 1));
+                sum += term;
+            }
+            return sum;
+        }
+        constexpr long double cos_series(long double x) {
+            long double term = 1, sum = 1;
+            for(u32 n = 1; n < 16 && term != 0; n++) {
+                term *= -x * x / ((long double)(2*n - 1) * (long double)(2*n));
+                sum += term;
+            }
+            return sum;
+        }
+    }
+
+    // e^(i*2pi*num/den), usable in constant expressions. The angle is reduced to the first octant on the integers, so
+    // it is as accurate for large num and den as it is for small ones
+    constexpr std::complex<long double> unit_root(u64 num, u64 den) {
+        constexpr long double half_pi = 1.570796326794896619231321691639751442L;
+        num %= den;
+        //the angle is quadrant * pi/2 + pi/2 * r/den, with r in [0, den)
+        const u64 quadrant = 4 * num / den, r = 4 * num - quadrant * den;
+        long double c, s;
+        if(2 * r <= den) {
+            const long double x = half_pi * (long double)(r) / (long double)(den);
+            c = detail::cos_series(x);
+            s = detail::sin_series(x);
+        } else {
+            //sin(x) = cos(pi/2 - x) and vice versa
+            const long double x = half_pi * (long double)(den - r) / (long double)(den);
+            c = detail::sin_series(x);
+            s = detail::cos_series(x);
+        }
+        switch(quadrant) {
+            case 0: return { c, s };
+            case 1: return { -s, c };
+            case 2: return { -c, -s };
+            default: return { s, -c };
+        }
+    }
+
+    // e^(i*2pi*k/N) for k in [0, n), split in real and imaginary parts; meant to initialize constexpr tables, which
+    // end up in read only memory with no initialization at runtime
+    template<std::floating_point T, u64 N, std::size_t n>
+    constexpr std::array<std::array<T, n>, 2> unit_roots() {
+        std::array<std::array<T, n>, 2> ret {};
+        for(std::size_t k = 0; k < n; k++) {
+            const std::complex<long double> w = unit_root(k, N);
+            ret[0][k] = T(w.real());
+            ret[1][k] = T(w.imag());
+        }
+        return ret;
+    }
+}
+
+#endif
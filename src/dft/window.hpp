@@ -0,0 +1,101 @@
+#ifndef dft_WINDOW_HPP
+#define dft_WINDOW_HPP
+
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <scluk/aliases.hpp>
+#include <scluk/math.hpp>
+#include "unit_root.hpp"
+
+namespace dft {
+    using namespace scluk::type_aliases;
+
+    enum class window_type : u8 { hann, hamming, blackman_harris, sqrt_hann };
+    constexpr std::array window_types = { window_type::hann, window_type::hamming, window_type::blackman_harris, window_type::sqrt_hann };
+
+    constexpr const char* window_name(window_type t) {
+        switch(t) {
+            case window_type::hann: return "hann";
+            case window_type::hamming: return "hamming";
+            case window_type::blackman_harris: return "blackman-harris";
+            case window_type::sqrt_hann: return "sqrt-hann";
+        }
+        return "?";
+    }
+
+    namespace detail {
+        //newton's method, for constant expressions
+        constexpr long double sqrt(long double x) {
+            if(x <= 0) return 0;
+            long double y = x > 1 ? x : 1;
+            for(long double prev = 0; y != prev;) {
+                prev = y;
+                y = (y + x / y) / 2;
+                //newton's method approaches the root from above; stop as soon as it stops going down
+                if(y >= prev) break;
+            }
+            return y;
+        }
+
+        template<std::floating_point T, std::size_t N>
+        constexpr std::array<std::array<T, N>, window_types.size()> make_window_tables() {
+            std::array<std::array<T, N>, window_types.size()> w {};
+            for(std::size_t i = 0; i < N; i++) {
+                const long double c1 = unit_root(i, N).real(), c2 = unit_root(2*i, N).real(), c3 = unit_root(3*i, N).real();
+                const long double hann = .5l - .5l * c1;
+                w[u8(window_type::hann)][i] = T(hann);
+                w[u8(window_type::hamming)][i] = T(.54l - .46l * c1);
+                w[u8(window_type::blackman_harris)][i] = T(.35875l - .48829l * c1 + .14128l * c2 - .01168l * c3);
+                w[u8(window_type::sqrt_hann)][i] = T(sqrt(hann));
+            }
+            return w;
+        }
+
+        //computed at compile time, so they sit in read only memory and are ready before any thread asks for them
+        template<std::floating_point T, std::size_t N>
+        inline constexpr std::array<std::array<T, N>, window_types.size()> window_tables = make_window_tables<T, N>();
+    }
+
+    // periodic window coefficients
+    template<std::floating_point T, std::size_t N>
+    constexpr const std::array<T, N>& window_table(window_type t) {
+        return detail::window_tables<T, N>[u8(t)];
+    }
+
+    template<std::floating_point T, std::size_t N>
+    constexpr const std::array<T, N>& hann_window() { return window_table<T, N>(window_type::hann); }
+
+    namespace detail {
+        //every window divided, sample by sample, by the sum of its squares over the frames overlapping that sample
+        template<std::floating_point T, std::size_t N, std::size_t overlap>
+        constexpr std::array<std::array<T, N>, window_types.size()> make_synthesis_window_tables() {
+            std::array<std::array<T, N>, window_types.size()> w {};
+            for(std::size_t t = 0; t < window_types.size(); t++)
+                for(std::size_t i = 0; i < N; i++) {
+                    long double sum = 0;
+                    for(std::size_t k = 0; k < overlap; k++) {
+                        const long double a = window_tables<T, N>[t][(i + k * (N / overlap)) % N];
+                        sum += a * a;
+                    }
+                    w[t][i] = T((long double)(window_tables<T, N>[t][i]) / sum);
+                }
+            return w;
+        }
+
+        template<std::floating_point T, std::size_t N, std::size_t overlap>
+        inline constexpr std::array<std::array<T, N>, window_types.size()> synthesis_window_tables = make_synthesis_window_tables<T, N, overlap>();
+    }
+
+    // the synthesis window that goes with the analysis window t when frames are placed every N/overlap samples: frames
+    // windowed by both overlap-add to exactly 1, whichever the window. A constant gain could only do that for pairs
+    // whose product is itself constant overlap-add, which hann and hann aren't at overlap 2, nor hamming or
+    // blackman-harris pairs at any overlap
+    template<std::floating_point T, std::size_t N, std::size_t overlap>
+    constexpr const std::array<T, N>& synthesis_window_table(window_type t) {
+        static_assert(N % overlap == 0, "the window size must be a multiple of the overlap factor");
+        return detail::synthesis_window_tables<T, N, overlap>[u8(t)];
+    }
+}
+
+#endif //dft_WINDOW_HPP
@@ -0,0 +1,269 @@
+#include "audio_file.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <cerrno>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace file {
+    namespace {
+        //wav files are little endian, like every machine this runs on
+        template<typename T>
+        T load(const std::byte* p) {
+            T v;
+            std::memcpy(&v, p, sizeof(T));
+            return v;
+        }
+
+        bool tag_is(const std::byte* p, const char (&tag)[5]) {
+            return std::memcmp(p, tag, 4) == 0;
+        }
+
+        template<typename T>
+        void store(std::byte* p, T v) {
+            std::memcpy(p, &v, sizeof(T));
+        }
+
+        //header of a 32 bit float wav file; sizes that don't fit are saturated, which readers take as "until the end
+        //of the file"
+        std::array<std::byte, 44> float_wav_header(u32 rate, u16 channels, u64 data_bytes) {
+            std::array<std::byte, 44> h {};
+            std::memcpy(&h[0], "RIFF", 4);
+            store<u32>(&h[4], u32(std::min<u64>(data_bytes + 36, std::numeric_limits<u32>::max())));
+            std::memcpy(&h[8], "WAVEfmt ", 8);
+            store<u32>(&h[16], 16);
+            store<u16>(&h[20], 3);//ieee float
+            store<u16>(&h[22], channels);
+            store<u32>(&h[24], rate);
+            store<u32>(&h[28], rate * channels * u32(sizeof(f32)));
+            store<u16>(&h[32], u16(channels * sizeof(f32)));
+            store<u16>(&h[34], 32);
+            std::memcpy(&h[36], "data", 4);
+            store<u32>(&h[40], u32(std::min<u64>(data_bytes, std::numeric_limits<u32>::max())));
+            return h;
+        }
+
+        void pwrite_all(int fd, const void* data, u64 bytes, u64 offset) {
+            const char* p = static_cast<const char*>(data);
+            while(bytes) {
+                const ssize_t w = ::pwrite(fd, p, bytes, off_t(offset));
+                if(w < 0) {
+                    if(errno == EINTR) continue;
+                    throw errno_error("write failed: ");
+                }
+                p += w;
+                bytes -= u64(w);
+                offset += u64(w);
+            }
+        }
+    }
+
+    u32 audio_format::bytes_per_sample() const {
+        switch(sample) {
+            case sample_format::i16: return 2;
+            case sample_format::i24: return 3;
+            case sample_format::i32: return 4;
+            case sample_format::f32: return 4;
+            case sample_format::f64: return 8;
+        }
+        return 0;
+    }
+
+    bool is_wav_path(const std::filesystem::path& p) {
+        std::string ext = p.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return char(std::tolower(c)); });
+        return ext == ".wav" || ext == ".wave";
+    }
+
+    audio_reader::audio_reader(const std::filesystem::path& path, audio_format raw_format) : file(path), fmt(raw_format) {
+        const std::span<const std::byte> b = file.bytes();
+        u64 data_bytes = b.size();
+
+        if(b.size() >= 12 && tag_is(&b[0], "RIFF") && tag_is(&b[8], "WAVE")) {
+            bool have_fmt = false, have_data = false;
+            for(u64 pos = 12; pos + 8 <= b.size() && !have_data;) {
+                const std::byte* chunk = &b[pos];
+                const u64 chunk_size = load<u32>(chunk + 4);
+                if(tag_is(chunk, "fmt ")) {
+                    if(chunk_size < 16 || pos + 8 + chunk_size > b.size())
+                        throw std::runtime_error(path.string() + ": truncated fmt chunk");
+                    u16 tag = load<u16>(chunk + 8);
+                    fmt.channels = load<u16>(chunk + 10);
+                    fmt.rate = load<u32>(chunk + 12);
+                    const u16 bits = load<u16>(chunk + 22);
+                    //WAVE_FORMAT_EXTENSIBLE keeps the real format tag at the start of the subformat guid
+                    if(tag == 0xfffe && chunk_size >= 40)
+                        tag = load<u16>(chunk + 32);
+
+                    if(tag == 1 && bits == 16) fmt.sample = sample_format::i16;
+                    else if(tag == 1 && bits == 24) fmt.sample = sample_format::i24;
+                    else if(tag == 1 && bits == 32) fmt.sample = sample_format::i32;
+                    else if(tag == 3 && bits == 32) fmt.sample = sample_format::f32;
+                    else if(tag == 3 && bits == 64) fmt.sample = sample_format::f64;
+                    else throw std::runtime_error(path.string() + ": unsupported wav sample format");
+                    have_fmt = true;
+                } else if(tag_is(chunk, "data")) {
+                    data_offset = pos + 8;
+                    //files over 4GB (or still being written) often carry a bogus size: trust the file instead
+                    data_bytes = std::min<u64>(chunk_size, b.size() - data_offset);
+                    if(chunk_size == 0 || chunk_size == std::numeric_limits<u32>::max())
+                        data_bytes = b.size() - data_offset;
+                    have_data = true;
+                }
+                //chunks are padded to an even size
+                pos += 8 + chunk_size + (chunk_size & 1);
+            }
+            if(!have_fmt || !have_data)
+                throw std::runtime_error(path.string() + ": wav file without fmt or data chunk");
+        }
+
+        if(fmt.channels == 0 || fmt.rate == 0)
+            throw std::runtime_error(path.string() + ": zero channels or zero sample rate");
+        n_frames = data_bytes / fmt.bytes_per_frame();
+    }
+
+    void audio_reader::read(u64 first, u64 n, std::span<f32> out) const {
+        if(first + n > n_frames || out.size() < n * fmt.channels)
+            throw std::out_of_range("audio_reader::read: frames out of range");
+
+        const std::byte* src = file.bytes().data() + data_offset + first * fmt.bytes_per_frame();
+        const u64 samples = n * fmt.channels;
+        switch(fmt.sample) {
+            case sample_format::i16:
+                for(u64 i = 0; i < samples; i++)
+                    out[i] = f32(load<i16>(src + 2*i)) * (1.f / 32768.f);
+                break;
+            case sample_format::i24:
+                for(u64 i = 0; i < samples; i++) {
+                    const std::byte* s = src + 3*i;
+                    //put the 24 bits at the top of an i32 so the sign comes along
+                    const i32 v = i32(u32(s[0]) << 8 | u32(s[1]) << 16 | u32(s[2]) << 24);
+                    out[i] = f32(v) * (1.f / 2147483648.f);
+                }
+                break;
+            case sample_format::i32:
+                for(u64 i = 0; i < samples; i++)
+                    out[i] = f32(load<i32>(src + 4*i)) * (1.f / 2147483648.f);
+                break;
+            case sample_format::f32:
+                std::memcpy(out.data(), src, samples * sizeof(f32));
+                break;
+            case sample_format::f64:
+                for(u64 i = 0; i < samples; i++)
+                    out[i] = f32(load<f64>(src + 8*i));
+                break;
+        }
+    }
+
+    void audio_reader::release_before(u64 first) const {
+        file.done_with(0, data_offset + first * fmt.bytes_per_frame());
+    }
+
+    void audio_reader::release(u64 first, u64 n) const {
+        file.done_with(data_offset + first * fmt.bytes_per_frame(), n * fmt.bytes_per_frame());
+    }
+
+    audio_writer::audio_writer(const std::filesystem::path& path, u32 rate, u16 channels, bool wav, u64 buffer_samples)
+        : wav(wav), channels(channels), buf(std::max<u64>(buffer_samples / channels, 1) * channels) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) throw errno_error("cannot create " + path.string() + ": ");
+        if(wav) write_wav_header(rate);
+    }
+
+    audio_writer::~audio_writer() {
+        if(fd >= 0) {
+            try { close(); }
+            catch(...) {}
+        }
+    }
+
+    void audio_writer::write_all(const void* data, u64 bytes) {
+        const char* p = static_cast<const char*>(data);
+        while(bytes) {
+            const ssize_t w = ::write(fd, p, bytes);
+            if(w < 0) {
+                if(errno == EINTR) continue;
+                throw errno_error("write failed: ");
+            }
+            p += w;
+            bytes -= u64(w);
+        }
+    }
+
+    void audio_writer::flush() {
+        write_all(buf.data(), buffered * sizeof(f32));
+        data_bytes += buffered * sizeof(f32);
+        buffered = 0;
+    }
+
+    void audio_writer::write_wav_header(u32 rate) {
+        //sizes are placeholders until close()
+        const std::array<std::byte, 44> h = float_wav_header(rate, channels, 0);
+        write_all(h.data(), h.size());
+    }
+
+    void audio_writer::write(std::span<const f32> interleaved) {
+        while(!interleaved.empty()) {
+            const u64 n = std::min<u64>(interleaved.size(), buf.size() - buffered);
+            std::copy(interleaved.begin(), interleaved.begin() + i64(n), buf.begin() + i64(buffered));
+            buffered += n;
+            interleaved = interleaved.subspan(n);
+            if(buffered == buf.size())
+                flush();
+        }
+    }
+
+    void audio_writer::close() {
+        try {
+            flush();
+            if(wav) {
+                //sizes that don't fit are saturated, which readers take as "until the end of the file"
+                const u32 data_size = u32(std::min<u64>(data_bytes, std::numeric_limits<u32>::max()));
+                const u32 riff_size = u32(std::min<u64>(data_bytes + 36, std::numeric_limits<u32>::max()));
+                if(::pwrite(fd, &riff_size, 4, 4) != 4 || ::pwrite(fd, &data_size, 4, 40) != 4)
+                    throw errno_error("cannot finish the wav header: ");
+            }
+        } catch(...) {
+            ::close(fd);
+            fd = -1;
+            throw;
+        }
+        const int f = fd;
+        fd = -1;
+        if(::close(f))
+            throw errno_error("close failed: ");
+    }
+
+    audio_block_writer::audio_block_writer(const std::filesystem::path& path, u32 rate, u16 channels, u64 frames, bool wav)
+        : channels(channels), data_offset(wav ? 44 : 0) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) throw errno_error("cannot create " + path.string() + ": ");
+        const u64 data_bytes = frames * channels * sizeof(f32);
+        if(::ftruncate(fd, off_t(data_offset + data_bytes))) {
+            ::close(fd);
+            throw errno_error("cannot resize " + path.string() + ": ");
+        }
+        if(wav) {
+            const std::array<std::byte, 44> h = float_wav_header(rate, channels, data_bytes);
+            pwrite_all(fd, h.data(), h.size(), 0);
+        }
+    }
+
+    audio_block_writer::~audio_block_writer() {
+        if(fd >= 0) ::close(fd);
+    }
+
+    void audio_block_writer::write(u64 first, std::span<const f32> interleaved) const {
+        pwrite_all(fd, interleaved.data(), interleaved.size_bytes(), data_offset + first * channels * sizeof(f32));
+    }
+
+    void audio_block_writer::close() {
+        const int f = fd;
+        fd = -1;
+        if(::close(f))
+            throw errno_error("close failed: ");
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef FILE_AUDIO_FILE_HPP
+#define FILE_AUDIO_FILE_HPP
+
+#include <filesystem>
+#include <span>
+#include <vector>
+#include <scluk/aliases.hpp>
+#include "mapped_file.hpp"
+
+namespace file {
+    using namespace scluk::type_aliases;
+
+    enum class sample_format : u8 { i16, i24, i32, f32, f64 };
+
+    struct audio_format {
+        u32 rate = 48000;
+        u16 channels = 1;
+        sample_format sample = sample_format::f32;
+
+        u32 bytes_per_sample() const;
+        u32 bytes_per_frame() const { return bytes_per_sample() * channels; }
+    };
+
+    bool is_wav_path(const std::filesystem::path& p);
+
+    // interleaved samples of a wav file (16/24/32 bit pcm or 32/64 bit float) or of a headerless file in a known
+    // format, converted to f32 straight out of a memory mapping of the file
+    class audio_reader {
+        mapped_file file;
+        audio_format fmt;
+        u64 data_offset = 0, n_frames = 0;
+    public:
+        // raw_format describes the file if it isn't a wav (i.e. it doesn't start with a RIFF/WAVE header)
+        audio_reader(const std::filesystem::path& path, audio_format raw_format);
+
+        const audio_format& format() const { return fmt; }
+        u64 frames() const { return n_frames; }
+
+        // converts frames [first, first + n) to f32 into out, interleaved; out must hold n * channels samples
+        void read(u64 first, u64 n, std::span<f32> out) const;
+        // the frames before first won't be read again, so the pages holding them can be dropped
+        void release_before(u64 first) const;
+        // the same for frames [first, first + n)
+        void release(u64 first, u64 n) const;
+    };
+
+    // writes interleaved f32 samples to a 32 bit float wav file, or a headerless one, through a big buffer; the wav
+    // header is written with placeholder sizes, which are filled in by close()
+    class audio_writer {
+        int fd = -1;
+        bool wav;
+        u16 channels;
+        std::vector<f32> buf;
+        u64 buffered = 0, data_bytes = 0;
+
+        void write_all(const void* data, u64 bytes);
+        void flush();
+        void write_wav_header(u32 rate);
+    public:
+        audio_writer(const std::filesystem::path& path, u32 rate, u16 channels, bool wav, u64 buffer_samples = 1 << 20);
+        audio_writer(const audio_writer&) = delete;
+        audio_writer& operator=(const audio_writer&) = delete;
+        // closes the file if close() wasn't called, ignoring errors
+        ~audio_writer();
+
+        void write(std::span<const f32> interleaved);
+        // flushes the buffer and finishes the header; throws on errors
+        void close();
+
+        u64 bytes_written() const { return data_bytes; }
+    };
+
+    // output file of known length that can be written in any order, from any number of threads at once: it is created
+    // at its final size (with a complete header if it's a wav) and every write goes straight to its place with pwrite
+    class audio_block_writer {
+        int fd = -1;
+        u16 channels;
+        u64 data_offset;
+    public:
+        audio_block_writer(const std::filesystem::path& path, u32 rate, u16 channels, u64 frames, bool wav);
+        audio_block_writer(const audio_block_writer&) = delete;
+        audio_block_writer& operator=(const audio_block_writer&) = delete;
+        ~audio_block_writer();
+
+        // writes interleaved.size() / channels frames starting at frame first
+        void write(u64 first, std::span<const f32> interleaved) const;
+        void close();
+    };
+}
+
+#endif //FILE_AUDIO_FILE_HPP
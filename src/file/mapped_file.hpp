@@ -0,0 +1,72 @@
+#ifndef FILE_MAPPED_FILE_HPP
+#define FILE_MAPPED_FILE_HPP
+
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <span>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <scluk/aliases.hpp>
+
+namespace file {
+    using namespace scluk::type_aliases;
+
+    inline std::runtime_error errno_error(const std::string& msg) {
+        return std::runtime_error(msg + std::strerror(errno));
+    }
+
+    // read only memory mapping of a whole file; pages are only read from disk as they are touched, so this is usable
+    // on files much bigger than the ram
+    class mapped_file {
+        const std::byte* m_data = nullptr;
+        u64 m_size = 0;
+    public:
+        explicit mapped_file(const std::filesystem::path& path) {
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0) throw errno_error("cannot open " + path.string() + ": ");
+
+            struct stat st;
+            if(::fstat(fd, &st)) {
+                ::close(fd);
+                throw errno_error("cannot stat " + path.string() + ": ");
+            }
+            m_size = u64(st.st_size);
+            if(m_size) {
+                void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(p == MAP_FAILED) {
+                    ::close(fd);
+                    throw errno_error("cannot map " + path.string() + ": ");
+                }
+                m_data = static_cast<const std::byte*>(p);
+                ::madvise(p, m_size, MADV_SEQUENTIAL);
+            }
+            //the mapping keeps the file alive on its own
+            ::close(fd);
+        }
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        ~mapped_file() {
+            if(m_data) ::munmap(const_cast<std::byte*>(m_data), m_size);
+        }
+
+        std::span<const std::byte> bytes() const { return { m_data, m_size }; }
+        u64 size() const { return m_size; }
+
+        // tells the kernel the given range won't be read again, so that its pages can be dropped right away instead of
+        // pushing other things out of the page cache
+        void done_with(u64 offset, u64 length) const {
+            const u64 page = u64(::sysconf(_SC_PAGESIZE));
+            const u64 begin = (offset + page - 1) / page * page, end = std::min(offset + length, m_size) / page * page;
+            if(end > begin)
+                ::madvise(const_cast<std::byte*>(m_data) + begin, end - begin, MADV_DONTNEED);
+        }
+    };
+}
+
+#endif //FILE_MAPPED_FILE_HPP
@@ -0,0 +1,201 @@
+#ifndef HARMONIZER_HPP
+#define HARMONIZER_HPP
+
+#include <cmath>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "phase_vocoder.hpp"
+#include "bypass_switch.hpp"
+#include "silence_gate.hpp"
+#include "telemetry/stats.hpp"
+
+//a voice of a harmonizer: a copy of the input shifted by semitones (on top of the harmonizer's own pitch), scaled by gain
+struct harmony_voice {
+    f32 semitones = 0.f, gain = 1.f;
+};
+
+// any number of pitch shifted voices of every channel of an interleaved stream, mixed together. All the voices of a
+// channel share one analysis: the input is windowed and transformed once per hop, and each voice then only pays for
+// its own phase adjustment and synthesis. These run a stage at a time over all the voices of the channel, so that
+// each stage finds its code and tables still in cache from the voice before. The channels are independent (there is
+// no mid/side mode). Like phase_vocoder it never allocates after construction, and like multichannel_vocoder it has
+// a bypass and a gate.
+template<u32 win, u32 overlap>
+class harmonizer {
+public:
+    using mono = phase_vocoder<win, overlap>;
+    using hop_chunk = typename mono::hop_chunk;
+    using hop_params = typename mono::hop_params;
+    using frame = typename mono::frame;
+    static constexpr u32 window_size = win;
+    static constexpr u32 hop_size = mono::hop_size;
+    //the hops process_hop() delays its output by, as in multichannel_vocoder
+    static constexpr u32 delay_hops = overlap - 1;
+    static constexpr u32 gate_hops = overlap + delay_hops;
+private:
+    using path = typename bypass_switch<hop_size>::path;
+    using verdict = typename silence_gate<gate_hops>::verdict;
+
+    struct voice_state {
+        harmony_voice voice;
+        f32 pitch_factor;
+        //every voice advances its phases at its own rate, so each needs its own phase state and overlap-add
+        typename mono::modification_stage modification;
+        typename mono::synthesis_stage synthesis;
+    };
+    struct channel_state {
+        typename mono::analysis_stage analysis;
+        std::unique_ptr<voice_state[]> voices;
+    };
+
+    u16 n_channels;
+    u32 n_voices;
+    hop_params params;
+    std::vector<std::unique_ptr<channel_state>> states;
+    //the analysis of the current channel, the copies of it the voices adjust, and what a voice synthesizes
+    frame analyzed;
+    std::vector<frame> voiced;
+    hop_chunk voice_out;
+    hop_reblocker<hop_size> reblocker;
+    //the voices warm up for delay_hops hops after the bypass, like the vocoders of multichannel_vocoder
+    bypass_switch<hop_size> bypass;
+    silence_gate<gate_hops> silence;
+    telemetry::audio_stats* stats = nullptr;
+public:
+    harmonizer(u16 channels, std::span<const harmony_voice> voices)
+        : n_channels(channels), n_voices(u32(voices.size())), voiced(voices.size()), reblocker(channels),
+          bypass(channels, delay_hops, delay_hops), silence(channels) {
+        if(channels == 0)
+            throw std::runtime_error("harmonizer: no channels");
+        if(voices.empty())
+            throw std::runtime_error("harmonizer: no voices");
+        for(u16 c = 0; c < channels; c++) {
+            states.push_back(std::make_unique<channel_state>());
+            states.back()->voices.reset(new voice_state[n_voices]);
+        }
+        for(u32 v = 0; v < n_voices; v++)
+            set_voice(v, voices[v]);
+    }
+
+    u16 channels() const { return n_channels; }
+    u32 voices() const { return n_voices; }
+    const harmony_voice& voice(u32 v) const { return states[0]->voices[v].voice; }
+    //changes the interval and gain of a voice; takes effect from the next hop
+    void set_voice(u32 v, harmony_voice h) {
+        for(auto& s : states) {
+            s->voices[v].voice = h;
+            s->voices[v].pitch_factor = std::pow(2.f, h.semitones / 12.f);
+            s->voices[v].synthesis.prepare(params.pitch_factor * s->voices[v].pitch_factor);
+        }
+    }
+
+    void reset() {
+        for(auto& s : states)
+            s->analysis.reset();
+        restart();
+        reblocker.reset();
+        bypass.reset();
+    }
+
+    //like multichannel_vocoder::set_bypass(): the output is the input delayed by latency(), and the voices are idle
+    void set_bypass(bool b) { bypass.set(b); }
+    bool is_bypassed() const { return bypass.is_set(); }
+    //like multichannel_vocoder::set_gate(): a gated channel skips its analysis and every voice
+    void set_gate(f32 threshold) { silence.set_threshold(threshold); }
+
+    //the pitch of the whole harmony: every voice is shifted by its own interval on top of this
+    void set_pitch_factor(f32 f) {
+        params.pitch_factor = f;
+        for(auto& s : states)
+            for(u32 v = 0; v < n_voices; v++)
+                s->voices[v].synthesis.prepare(f * s->voices[v].pitch_factor);
+    }
+    void set_pitch_semitones(f32 semitones) { set_pitch_factor(std::pow(2.f, semitones / 12.f)); }
+    void set_window(dft::window_type t) { params.window = t; }
+    const hop_params& get_params() const { return params; }
+    //like multichannel_vocoder::set_stats(); the stages of every voice are recorded as those of its channel
+    void set_stats(telemetry::audio_stats* s) { stats = s; }
+
+    //spectrum of the last analyzed window of a channel
+    const typename mono::sliding_dft& spectrum(u16 c) const { return states[c]->analysis.spectrum(); }
+    //brings the spectrum of a channel up to date, if hops went by without being transformed (see set_bypass())
+    void refresh_spectrum(u16 c) { states[c]->analysis.refresh(params); }
+
+    static constexpr u32 latency() { return mono::latency(); }
+
+    //one hop of every channel, planar: in and out hold channels() hops each (and may be the same memory)
+    void process_hop(std::span<const hop_chunk> in, std::span<hop_chunk> out) {
+        const telemetry::scoped_timer timer(stats, telemetry::stage::hop);
+        if(bypass.begin_hop(in) == path::dry)
+            for(u16 c = 0; c < n_channels; c++)
+                states[c]->analysis.skip(in[c]);
+        else {
+            if(bypass.restarts()) restart();
+            process_wet(in, out);
+        }
+        bypass.end_hop(out);
+    }
+
+    //processes any number of interleaved frames; out must be as long as in (and may be the same memory)
+    void process(std::span<const f32> in, std::span<f32> out) {
+        reblocker.process(in, out, [this](std::span<const hop_chunk> i, std::span<hop_chunk> o) { process_hop(i, o); });
+    }
+
+private:
+    //every voice of every channel on a hop, and the gate
+    void process_wet(std::span<const hop_chunk> in, std::span<hop_chunk> out) {
+        using telemetry::scoped_timer, telemetry::stage;
+        for(u16 c = 0; c < n_channels; c++) {
+            channel_state& s = *states[c];
+            const verdict g = silence.count(c, silence.is_silent(in[c]));
+            if(g == verdict::skip) {
+                s.analysis.skip(in[c]);
+                out[c].fill(0.f);
+                continue;
+            }
+            if(g == verdict::restart) restart(s);
+            {
+                const scoped_timer timer(stats, stage::analysis, c);
+                s.analysis.run(in[c], params, analyzed);
+            }
+            //the voices have different periods, hence ifft plans of different sizes, so there is no transform to share
+            //between them; they go through each stage together instead
+            {
+                const scoped_timer timer(stats, stage::modification, c);
+                for(u32 v = 0; v < n_voices; v++) {
+                    voiced[v] = analyzed;
+                    voiced[v].params.pitch_factor *= s.voices[v].pitch_factor;
+                    s.voices[v].modification.run(voiced[v]);
+                }
+            }
+            {
+                const scoped_timer timer(stats, stage::ifft, c);
+                for(u32 v = 0; v < n_voices; v++)
+                    s.voices[v].synthesis.transform(voiced[v]);
+            }
+            const scoped_timer timer(stats, stage::overlap_add, c);
+            out[c].fill(0.f);
+            for(u32 v = 0; v < n_voices; v++) {
+                s.voices[v].synthesis.overlap_add(voice_out);
+                for(u32 i = 0; i < hop_size; i++)
+                    out[c][i] += s.voices[v].voice.gain * voice_out[i];
+            }
+        }
+    }
+
+    //the phases and overlap-adds of every voice of a channel start over
+    void restart(channel_state& s) {
+        for(u32 v = 0; v < n_voices; v++) {
+            s.voices[v].modification.reset();
+            s.voices[v].synthesis.reset();
+        }
+    }
+    void restart() {
+        for(auto& s : states) restart(*s);
+        silence.reset();
+    }
+};
+
+#endif //HARMONIZER_HPP
@@ -0,0 +1,61 @@
+#ifndef HOP_REBLOCKER_HPP
+#define HOP_REBLOCKER_HPP
+
+#include <array>
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include <scluk/aliases.hpp>
+
+using namespace scluk::type_aliases;
+
+// turns an interleaved stream of any number of channels, in blocks of any size, into planar hops of hop_size frames
+// and back, for whatever processes a hop at a time: every frame that goes in takes the place of a frame of the output
+// of the hop before, so the output comes a hop late. Its buffers are allocated by the constructor
+template<u32 hop_size>
+class hop_reblocker {
+public:
+    using hop_chunk = std::array<f32, hop_size>;
+private:
+    std::vector<hop_chunk> in_hops, out_hops;
+    u32 hop_fill = 0;
+public:
+    explicit hop_reblocker(u16 channels) : in_hops(channels), out_hops(channels) { reset(); }
+
+    void reset() {
+        for(hop_chunk& h : in_hops) h.fill(0.f);
+        for(hop_chunk& h : out_hops) h.fill(0.f);
+        hop_fill = 0;
+    }
+
+    // processes any number of interleaved frames; out must be as long as in (and may be the same memory).
+    // process_hop(in, out) is called on spans of channels() hops every time a hop of input is complete
+    template<typename hop_fn>
+    void process(std::span<const f32> in, std::span<f32> out, hop_fn&& process_hop) {
+        const u16 n_channels = u16(in_hops.size());
+        if(in.size() != out.size())
+            throw std::runtime_error("hop_reblocker::process: input and output sizes differ");
+        if(in.size() % n_channels)
+            throw std::runtime_error("hop_reblocker::process: not a whole number of frames");
+
+        const std::size_t frames = in.size() / n_channels;
+        for(std::size_t i = 0; i < frames;) {
+            const std::size_t n = std::min(std::size_t(hop_size - hop_fill), frames - i);
+            for(std::size_t j = 0; j < n; j++)
+                for(u16 c = 0; c < n_channels; c++) {
+                    const f32 sample = in[(i + j) * n_channels + c];
+                    out[(i + j) * n_channels + c] = out_hops[c][hop_fill + j];
+                    in_hops[c][hop_fill + j] = sample;
+                }
+            hop_fill += u32(n);
+            i += n;
+            if(hop_fill == hop_size) {
+                process_hop(std::span<const hop_chunk>(in_hops), std::span<hop_chunk>(out_hops));
+                hop_fill = 0;
+            }
+        }
+    }
+};
+
+#endif //HOP_REBLOCKER_HPP
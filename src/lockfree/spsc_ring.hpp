@@ -0,0 +1,97 @@
+#ifndef LOCKFREE_SPSC_RING_HPP
+#define LOCKFREE_SPSC_RING_HPP
+
+#include <atomic>
+#include <array>
+#include <span>
+#include <bit>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+
+namespace lockfree {
+    //size of a cache line on every cpu we care about; std::hardware_destructive_interference_size is not stable across compiler flags
+    constexpr std::size_t cache_line = 64;
+
+    // wait-free single producer single consumer ring buffer with a fixed capacity, meant to move samples in and out of
+    // a realtime audio callback: one thread may only push and the other may only pop, and neither ever blocks, locks
+    // or allocates. The read and write indices live on separate cache lines (each next to the copy of the other index
+    // its owner last saw), so the two threads only touch each other's lines when they have to.
+    template<typename T, std::size_t capacity>
+    class spsc_ring {
+        static_assert(std::has_single_bit(capacity), "the capacity of an spsc_ring must be a power of two");
+        static_assert(std::is_trivially_copyable_v<T>);
+        static constexpr std::size_t mask = capacity - 1;
+
+        //producer side
+        alignas(cache_line) std::atomic<std::size_t> write_idx = 0;
+        std::size_t cached_read_idx = 0;
+        //consumer side
+        alignas(cache_line) std::atomic<std::size_t> read_idx = 0;
+        std::size_t cached_write_idx = 0;
+
+        alignas(cache_line) std::array<T, capacity> buf;
+    public:
+        static constexpr std::size_t max_size() { return capacity; }
+
+        //how many elements are waiting to be popped; exact when called by the consumer, a lower bound otherwise
+        std::size_t size() const {
+            return write_idx.load(std::memory_order_acquire) - read_idx.load(std::memory_order_acquire);
+        }
+
+        //producer only: how many elements push() would accept right now
+        std::size_t space() {
+            cached_read_idx = read_idx.load(std::memory_order_acquire);
+            return capacity - (write_idx.load(std::memory_order_relaxed) - cached_read_idx);
+        }
+
+        //producer only: pushes all of data, or nothing if it doesn't fit
+        bool push(std::span<const T> data) {
+            const std::size_t w = write_idx.load(std::memory_order_relaxed);
+            if(capacity - (w - cached_read_idx) < data.size()) {
+                cached_read_idx = read_idx.load(std::memory_order_acquire);
+                if(capacity - (w - cached_read_idx) < data.size())
+                    return false;
+            }
+
+            const std::size_t start = w & mask, first = std::min(data.size(), capacity - start);
+            std::copy(data.begin(), data.begin() + std::ptrdiff_t(first), buf.begin() + std::ptrdiff_t(start));
+            std::copy(data.begin() + std::ptrdiff_t(first), data.end(), buf.begin());
+
+            write_idx.store(w + data.size(), std::memory_order_release);
+            return true;
+        }
+
+        //consumer only: fills all of data, or pops nothing if there aren't enough elements
+        bool pop(std::span<T> data) {
+            const std::size_t r = read_idx.load(std::memory_order_relaxed);
+            if(cached_write_idx - r < data.size()) {
+                cached_write_idx = write_idx.load(std::memory_order_acquire);
+                if(cached_write_idx - r < data.size())
+                    return false;
+            }
+
+            const std::size_t start = r & mask, first = std::min(data.size(), capacity - start);
+            std::copy(buf.begin() + std::ptrdiff_t(start), buf.begin() + std::ptrdiff_t(start + first), data.begin());
+            std::copy(buf.begin(), buf.begin() + std::ptrdiff_t(data.size() - first), data.begin() + std::ptrdiff_t(first));
+
+            read_idx.store(r + data.size(), std::memory_order_release);
+            return true;
+        }
+
+        //consumer only: pops as many elements as are available, up to data.size(), and returns how many it popped
+        std::size_t pop_some(std::span<T> data) {
+            const std::size_t r = read_idx.load(std::memory_order_relaxed);
+            if(cached_write_idx - r < data.size())
+                cached_write_idx = write_idx.load(std::memory_order_acquire);
+            const std::size_t n = std::min(data.size(), cached_write_idx - r);
+            pop(data.first(n));
+            return n;
+        }
+
+        bool push(const T& v) { return push(std::span<const T>(&v, 1)); }
+        bool pop(T& v) { return pop(std::span<T>(&v, 1)); }
+    };
+}
+
+#endif //LOCKFREE_SPSC_RING_HPP
@@ -1,90 +1,159 @@
-#include <cmath>
-#include <cstring>
-#include <cassert>
-#include <complex>
-#include <filesystem>
-
-#include <signal.h>
-#include <boost/fiber/buffered_channel.hpp>
-
-#include <scluk/language_extension.hpp>
-#include <scluk/math.hpp>
-#include <scluk/array.hpp>
-#include <scluk/functional.hpp>
-#include <scluk/sliding_queue.hpp>
-
-#include "dft/sliding_dft.hpp"
-#include "sdl_gui_thread.hpp"
-#include "audio_params.hpp"
-
-int main() {
-    using namespace scluk::language_extension;
-
-    std::filesystem::current_path(EXECUTABLE_DIR);
-
-    sdl_gui_thread gui_thread;
-
-	//interrupt signal handling
-    signal(SIGINT, scluk::lambda_to_fnptr<void(int)>([&gui_thread](int) {
-        out("caught sigint!");
-        gui_thread.data.do_exit = true;
-    }));
-
-    audio::sliding_dft dft;
-    audio::duplex_chan cb_chan;
-    portaudio::async_stream stream({ .frames_per_buffer=audio::ft_dist, .rate=audio::rate, .log=EXECUTABLE_DIR"/log.txt" }, audio::cb, cb_chan);
-
-    scluk::sliding_queue<audio::ift_chunk, audio::ift_overlap> ift_queue(audio::ift_chunk(0.f));
-    //first iteration, just to populate the arrays
-    dft.push_frames(cb_chan.cb_to_main.value_pop());
-    audio::dft_array phase_adjusted_dft(dft), old_dft(dft);
-
-    //main loop
-    while(!gui_thread.data.do_exit) {
-        //push the frames received from portaudio
-        dft.push_frames_fft(cb_chan.cb_to_main.value_pop());
-
-        const f32 pitch_mul = gui_thread.data.do_apply_effect ? std::pow(2.f, f32(gui_thread.data.pitch)/12.f) : 1.f;
-        //phase adjustment to avoid artifacts (this is what makes this a phase vocoder)
-        for(u64 i : index(dft)) {
-            using std::abs, std::arg;
-            using scluk::math::pi;
-
-            //p means phase, A means amplitude
-            const f32 p_new = arg(dft[i]), p_old = arg(old_dft[i]), 
-                      p_old_adj = arg(phase_adjusted_dft[i]), A_new = abs(dft[i]);
-
-            //integer division allows me to automatically floor without additional cost
-            const f32 unwrap_addend = 2.f*pi * f32(i / audio::ift_overlap);
-
-            const f32 raw_p_delta = p_new - p_old;
-            const f32 mod_p_delta = raw_p_delta + std::signbit(raw_p_delta) * 2.f*pi;
-
-            const f32 adj_p_delta = (unwrap_addend + mod_p_delta) * pitch_mul;
-            const f32 p_new_adj = p_old_adj + adj_p_delta;
-
-            phase_adjusted_dft[i] = std::polar(A_new, p_new_adj);
-        }
-
-        //calculate the latest ift, apply the hann window and enqueue it
-        ift_queue << scluk::math::hann_window(phase_adjusted_dft.ifft<audio::ft_win>(pitch_mul));
-
-        audio::frame_chunk frames(0.f);
-
-        for(u64 n : index(ift_queue)) {
-            u64 starting_index = (audio::ift_overlap-1 - n) * audio::ft_dist;
-
-            for(u64 i : range(audio::ft_dist))
-                frames[i] += ift_queue[n][starting_index + i];
-        }
-
-        //send the frames to the callback
-        if(gui_thread.data.do_output_audio)
-            cb_chan.main_to_cb.push(std::move(frames));
-        else cb_chan.main_to_cb.push(audio::frame_chunk(0.f));
-
-        //send the old dft to the gui and repopulate it
-        gui_thread.channel.try_push(std::move(old_dft));
-        old_dft = dft;
-    }
-}
+#include <cmath>
+#include <cstring>
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <span>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include <signal.h>
+#include <boost/fiber/buffered_channel.hpp>
+
+#include <scluk/language_extension.hpp>
+#include <scluk/math.hpp>
+#include <scluk/array.hpp>
+#include <scluk/functional.hpp>
+#include <scluk/sliding_queue.hpp>
+
+#include "sdl_gui_thread.hpp"
+#include "audio_params.hpp"
+#include "offline.hpp"
+#include "batch/batch_runner.hpp"
+
+int main(int argc, char** argv) {
+    using namespace scluk::language_extension;
+
+    //file mode, when asked for on the command line; the interactive mode takes its options from there too
+    offline::options opts;
+    std::unique_ptr<any_vocoder> vocoder;
+    try {
+        opts = offline::parse_cli(argc, argv);
+        if(!opts.interactive) {
+            if(opts.help) out(offline::usage());
+            else if(opts.batch) return batch::run(opts) ? 1 : 0;
+            else offline::run(opts);
+            return 0;
+        }
+        if(opts.help) {
+            out(offline::usage());
+            return 0;
+        }
+        const u16 channels = opts.raw_format.channels;
+        vocoder = offline::vocoder_for(opts, channels, std::thread::hardware_concurrency());
+    } catch(const std::exception& e) {
+        out("%\n%", e.what(), offline::usage());
+        return 1;
+    }
+
+    std::filesystem::current_path(EXECUTABLE_DIR);
+
+    //on a simulated device the program runs headless, with the controls of the gui left as the command line sets them
+    const std::unique_ptr<sdl_gui_thread> gui_thread = opts.simulation ? nullptr : std::make_unique<sdl_gui_thread>();
+    sdl_gui_thread::gui_info_t headless;
+    headless.do_apply_effect = true;
+    sdl_gui_thread::gui_info_t& controls = gui_thread ? gui_thread->data : headless;
+    //the gui starts out showing the pitch (to the nearest semitone) and window of the command line, and the vocoder
+    //keeps those of the command line until they are changed on the gui
+    controls.pitch = i32(std::lround(opts.semitones));
+    controls.window = opts.window;
+    vocoder->set_pitch_semitones(opts.semitones);
+    vocoder->set_window(opts.window);
+
+	//interrupt signal handling
+    signal(SIGINT, scluk::lambda_to_fnptr<void(int)>([&controls](int) {
+        out("caught sigint!");
+        controls.do_exit = true;
+    }));
+
+    const u16 channels = vocoder->channels();
+    const u32 rate = opts.raw_format.rate, hop = vocoder->hop_size();
+    out("window % overlap %, % channels at % Hz%; processing latency: % samples (% ms)", vocoder->window_size(),
+        vocoder->overlap(), channels, rate, vocoder->is_pipelined() ? ", pipelined" : "", vocoder->latency(),
+        1e3 * f64(vocoder->latency()) / f64(rate));
+    const std::unique_ptr<audio::duplex_ring> cb_ring = std::make_unique<audio::duplex_ring>(channels, hop);
+    //the callback and the vocoder time themselves into these, if asked to
+    const std::unique_ptr<telemetry::audio_stats> stats = offline::stats_for(opts, rate, hop);
+    vocoder->set_stats(stats.get());
+    cb_ring->stats = stats.get();
+    auto xruns = [&cb_ring] {
+        return sout("ring overruns: %, underruns: %; portaudio input underflows: %, overflows: %, output underflows: %, overflows: %",
+            cb_ring->overruns.load(), cb_ring->underruns.load(), cb_ring->input_underflows.load(), cb_ring->input_overflows.load(),
+            cb_ring->output_underflows.load(), cb_ring->output_overflows.load());
+    };
+    portaudio::async_stream stream({ .frames_per_buffer=audio::host_buffer, .rate=rate, .i_chans=u8(channels),
+        .o_chans=u8(channels), .log=EXECUTABLE_DIR"/log.txt", .simulated=opts.simulation ? &*opts.simulation : nullptr },
+        audio::cb, *cb_ring);
+    std::optional<telemetry::reporter> reporter;
+    if(opts.stats_period > 0.)
+        reporter.emplace(*stats, std::chrono::milliseconds(u64(opts.stats_period * 1e3)), xruns);
+    //a simulation stops by itself after sim_seconds, if given
+    const auto end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<f64>(opts.sim_seconds));
+    auto exiting = [&controls, &opts, end] {
+        return controls.do_exit || (opts.simulation && opts.sim_seconds > 0. && std::chrono::steady_clock::now() >= end);
+    };
+    //a hop of every channel, and pointers to them in the form the vocoder and the rings take
+    std::vector<std::vector<f32>> frames(channels, std::vector<f32>(hop, 0.f));
+    std::vector<f32*> frame_ptrs;
+    for(std::vector<f32>& channel : frames) frame_ptrs.push_back(channel.data());
+
+    audio::spectrum_buffer gui_dft(vocoder->bins(), 0.f);
+    //the gui sends its buffers back once it is done with them; this is the first one it will hand us
+    if(gui_thread) gui_thread->recycle.push(std::move(gui_dft));
+
+    //everything the loop uses is allocated by now, so that locking memory covers it
+    if(opts.realtime) {
+        const std::vector<std::string> warnings = parallel::make_realtime(*opts.realtime);
+        for(const std::string& w : warnings)
+            out("warning: %", w);
+        if(warnings.empty())
+            out("realtime: SCHED_FIFO%, memory locked, denormals flushed",
+                opts.realtime->cpu ? sout(", pinned to cpu %", *opts.realtime->cpu) : std::string());
+    }
+
+    //main loop
+    i32 applied_pitch = controls.pitch;
+    dft::window_type applied_window = controls.window;
+    while(!exiting()) {
+        if(const i32 pitch = controls.pitch; pitch != applied_pitch)
+            vocoder->set_pitch_semitones(f32(applied_pitch = pitch));
+        if(const dft::window_type window = controls.window; window != applied_window)
+            vocoder->set_window(applied_window = window);
+        //with the effect off the audio goes through the delay line of the bypass, and the ffts rest
+        vocoder->set_bypass(!controls.do_apply_effect);
+
+        //process the frames received from portaudio in place
+        if(!cb_ring->pop_input(frame_ptrs, exiting)) break;
+        vocoder->process_hop(frame_ptrs, frame_ptrs);
+
+        //send the frames to the callback
+        if(!controls.do_output_audio)
+            for(std::vector<f32>& channel : frames)
+                std::fill(channel.begin(), channel.end(), 0.f);
+        if(!cb_ring->push_output(frame_ptrs, exiting)) break;
+
+        //hand the gui the magnitudes of the spectrum (of the first channel, or of the mid) whenever it has given a
+        //buffer back
+        if(gui_thread && gui_thread->recycle.try_pop(gui_dft) == boost::fibers::channel_op_status::success) {
+            gui_dft.resize(vocoder->bins());
+            vocoder->magnitudes(gui_dft);
+            gui_thread->channel.try_push(std::move(gui_dft));
+        }
+    }
+
+    reporter.reset();
+    out("%", xruns());
+    if(stats && opts.stats_period > 0.)
+        out("%", telemetry::report(*stats));
+    if(stats && !opts.trace.empty()) {
+        //the callback may still be recording; the trace only has to be roughly consistent
+        try {
+            telemetry::write_chrome_trace(*stats, opts.trace);
+        } catch(const std::exception& e) {
+            out("%", e.what());
+        }
+    }
+}
@@ -0,0 +1,277 @@
+#ifndef MULTICHANNEL_VOCODER_HPP
+#define MULTICHANNEL_VOCODER_HPP
+
+#include <array>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "phase_vocoder.hpp"
+#include "bypass_switch.hpp"
+#include "silence_gate.hpp"
+#include "parallel/fork_join.hpp"
+#include "telemetry/stats.hpp"
+
+//how the channels of a stream relate to each other
+enum class channel_mode : u8 {
+    //every channel through its own vocoder, unaware of the others
+    independent,
+    //stereo only: the mid (l+r) and side (l-r) signals through two phase locked vocoders, so that the phase
+    //difference between left and right, and with it the stereo image, survives the pitch shift
+    mid_side,
+};
+
+// phase vocoder over an interleaved stream of any number of channels, one vocoder per channel. When there are enough
+// independent channels for it to pay off they are processed in parallel, each thread always taking the same channels
+// (and so always touching the same vocoder state). Like phase_vocoder it never allocates after construction.
+// Two fast paths skip the ffts of hops whose output is known anyway: the bypass (see set_bypass()) plays the input
+// through a delay line as long as the latency of the vocoder, and the gate (see set_gate()) silences channels whose
+// input has been silent for long enough to have left the window and the overlap-add.
+template<u32 win, u32 overlap>
+class multichannel_vocoder {
+public:
+    using mono = phase_vocoder<win, overlap>;
+    using hop_chunk = typename mono::hop_chunk;
+    using hop_params = typename mono::hop_params;
+    using frame = typename mono::frame;
+    static constexpr u32 window_size = win;
+    static constexpr u32 hop_size = mono::hop_size;
+    //channels below this are cheaper to process one after the other than to hand to other threads
+    static constexpr u16 min_parallel_channels = 4;
+    //the hops process_hop() delays its output by: the window minus the hop the newest frame contributes to right away
+    static constexpr u32 delay_hops = overlap - 1;
+    //silent hops it takes for a channel's output to be silent too: a window of them leaves the analysis silent, and
+    //delay_hops more flush what the overlap-add still holds of the hops before
+    static constexpr u32 gate_hops = overlap + delay_hops;
+private:
+    using path = typename bypass_switch<hop_size>::path;
+
+    u16 n_channels;
+    channel_mode mode;
+    hop_params params;
+    std::vector<std::unique_ptr<mono>> vocoders;
+    hop_reblocker<hop_size> reblocker;
+    //the frames of process_hop()
+    std::vector<frame> frames;
+    //the mid and side of the hop being analyzed
+    std::array<hop_chunk, 2> encoded;
+    std::unique_ptr<parallel::fork_join> team;
+
+    //the vocoders warm up for delay_hops hops after the bypass, until the overlap-add is full again
+    bypass_switch<hop_size> bypass;
+    //counts the silent hops of every channel (of the pair, in mid/side mode, which only gates when both channels are
+    //silent)
+    silence_gate<gate_hops> silence;
+    //where process_hop() times its stages, if anywhere
+    telemetry::audio_stats* stats = nullptr;
+
+    static u32 parts_for(u16 channels, channel_mode mode, u32 threads) {
+        if(mode != channel_mode::independent || channels < min_parallel_channels) return 1;
+        return std::clamp<u32>(threads, 1, channels);
+    }
+public:
+    // threads is an upper bound on the threads processing the channels, counting the caller's
+    multichannel_vocoder(u16 channels, channel_mode mode = channel_mode::independent, u32 threads = 1)
+        : n_channels(channels), mode(mode), reblocker(channels), frames(channels),
+          bypass(channels, delay_hops, delay_hops), silence(channels) {
+        if(channels == 0)
+            throw std::runtime_error("multichannel_vocoder: no channels");
+        if(mode == channel_mode::mid_side && channels != 2)
+            throw std::runtime_error("multichannel_vocoder: mid/side processing needs exactly 2 channels");
+        for(u16 c = 0; c < channels; c++)
+            vocoders.push_back(std::make_unique<mono>());
+        if(const u32 parts = parts_for(channels, mode, threads); parts > 1)
+            team = std::make_unique<parallel::fork_join>(parts);
+    }
+
+    u16 channels() const { return n_channels; }
+    channel_mode get_mode() const { return mode; }
+    //threads processing the channels, counting the caller's
+    u32 threads() const { return team ? team->size() : 1; }
+
+    void reset() {
+        for(auto& v : vocoders) v->reset();
+        reblocker.reset();
+        bypass.reset();
+        silence.reset();
+    }
+
+    // while bypassed the output is the input delayed by latency(), and the vocoders are idle but for sliding the
+    // input into their analysis windows. Switching crossfades over a hop, so that the effect can be toggled without
+    // clicks; switching back on takes delay_hops more hops, while the vocoders fill the overlap-add again
+    void set_bypass(bool b) { bypass.set(b); }
+    bool is_bypassed() const { return bypass.is_set(); }
+    // hops peaking at or below threshold are silent; once gate_hops of them in a row have gone into a channel its
+    // output is silence, and its vocoder skips the ffts until the input comes back (starting afresh, as the state left
+    // from before the silence is of no use). The default only gates digital silence, whose output would be exactly
+    // zero anyway; a negative threshold turns the gate off
+    void set_gate(f32 threshold) { silence.set_threshold(threshold); }
+    // process_hop() records the time every stage of every channel takes into stats (null for none), which must
+    // outlive the vocoder. The stage functions below, which other threads may be running, are never timed
+    void set_stats(telemetry::audio_stats* s) { stats = s; }
+
+    //builds the ifft plan for a new pitch, so that the synthesis (wherever it runs) only has to look it up
+    void set_pitch_factor(f32 f) {
+        if(f != params.pitch_factor) mono::dft_array::prepare_ifft(f);
+        params.pitch_factor = f;
+    }
+    void set_pitch_semitones(f32 semitones) { set_pitch_factor(std::pow(2.f, semitones / 12.f)); }
+    void set_window(dft::window_type t) { params.window = t; }
+    const hop_params& get_params() const { return params; }
+
+    //the vocoder of a channel; in mid/side mode channel 0 is the mid and channel 1 the side
+    const mono& channel(u16 c) const { return *vocoders[c]; }
+    //brings the spectrum of a channel up to date, if hops went by without being transformed (see set_bypass())
+    void refresh_spectrum(u16 c) { vocoders[c]->analysis_state().refresh(params); }
+
+    static constexpr u32 latency() { return mono::latency(); }
+
+    //the three stages of a hop of every channel, for callers that keep the frames (channels() of them) between the
+    //stages themselves. Each stage only touches its own state, so different stages may run on different threads, as
+    //long as every stage sees the hops in order; they never use the parallel team
+    void analyze(std::span<const hop_chunk> in, const hop_params& p, std::span<frame> out) {
+        in = encode(in);
+        for(u16 c = 0; c < n_channels; c++)
+            vocoders[c]->analysis_state().run(in[c], p, out[c]);
+    }
+    void modify(std::span<frame> f) {
+        if(mode == channel_mode::mid_side)
+            return mono::modification_stage::run_locked(vocoders[0]->modification_state(), f[0], vocoders[1]->modification_state(), f[1]);
+        for(u16 c = 0; c < n_channels; c++)
+            vocoders[c]->modification_state().run(f[c]);
+    }
+    void synthesize(std::span<const frame> f, std::span<hop_chunk> out) {
+        for(u16 c = 0; c < n_channels; c++)
+            vocoders[c]->synthesis_state().run(f[c], out[c]);
+        decode(out);
+    }
+
+    //one hop of every channel, planar: in and out hold channels() hops each (and may be the same memory)
+    void process_hop(std::span<const hop_chunk> in, std::span<hop_chunk> out) {
+        const telemetry::scoped_timer timer(stats, telemetry::stage::hop);
+        if(bypass.begin_hop(in) == path::dry) skip(in);
+        else {
+            if(bypass.restarts()) restart();
+            process_wet(in, out);
+        }
+        bypass.end_hop(out);
+    }
+
+private:
+    //the vocoders, and the gate, on a hop
+    void process_wet(std::span<const hop_chunk> in, std::span<hop_chunk> out) {
+        if(mode == channel_mode::mid_side) {
+            if(gate(0, silence.is_silent(in[0]) && silence.is_silent(in[1]))) {
+                skip(in);
+                for(hop_chunk& h : out.first(2)) h.fill(0.f);
+                return;
+            }
+            {
+                const telemetry::scoped_timer timer(stats, telemetry::stage::analysis);
+                analyze(in, params, frames);
+            }
+            {
+                const telemetry::scoped_timer timer(stats, telemetry::stage::modification);
+                modify(frames);
+            }
+            for(u16 c = 0; c < 2; c++)
+                synthesize_timed(c, frames[c], out[c]);
+            decode(out);
+            return;
+        }
+
+        auto channel_job = [&](u16 c) {
+            mono& v = *vocoders[c];
+            if(gate(c, silence.is_silent(in[c]))) {
+                v.analysis_state().skip(in[c]);
+                out[c].fill(0.f);
+                return;
+            }
+            {
+                const telemetry::scoped_timer timer(stats, telemetry::stage::analysis, c);
+                v.analysis_state().run(in[c], params, frames[c]);
+            }
+            {
+                const telemetry::scoped_timer timer(stats, telemetry::stage::modification, c);
+                v.modification_state().run(frames[c]);
+            }
+            synthesize_timed(c, frames[c], out[c]);
+        };
+        if(!team) {
+            for(u16 c = 0; c < n_channels; c++)
+                channel_job(c);
+            return;
+        }
+        auto job = [&](u32 part) {
+            for(u16 c = u16(part); c < n_channels; c += u16(threads()))
+                channel_job(c);
+        };
+        team->run(job);
+    }
+
+    void synthesize_timed(u16 c, const frame& f, hop_chunk& out) {
+        typename mono::synthesis_stage& s = vocoders[c]->synthesis_state();
+        {
+            const telemetry::scoped_timer timer(stats, telemetry::stage::ifft, c);
+            s.transform(f);
+        }
+        const telemetry::scoped_timer timer(stats, telemetry::stage::overlap_add, c);
+        s.overlap_add(out);
+    }
+
+    //counts a hop of channel c (or of the pair, in mid/side mode) in or out of the silence; returns whether its
+    //processing can be skipped
+    bool gate(u16 c, bool silent) {
+        using verdict = typename silence_gate<gate_hops>::verdict;
+        const verdict v = silence.count(c, silent);
+        if(v == verdict::restart)
+            for(u16 r = c; r < (mode == channel_mode::mid_side ? 2 : c + 1); r++) {
+                vocoders[r]->modification_state().reset();
+                vocoders[r]->synthesis_state().reset();
+            }
+        return v == verdict::skip;
+    }
+
+    //the hops the vocoders take in: the input itself, or in mid/side mode its mid and side
+    std::span<const hop_chunk> encode(std::span<const hop_chunk> in) {
+        if(mode != channel_mode::mid_side) return in;
+        for(u32 i = 0; i < hop_size; i++) {
+            encoded[0][i] = .5f * (in[0][i] + in[1][i]);
+            encoded[1][i] = .5f * (in[0][i] - in[1][i]);
+        }
+        return encoded;
+    }
+
+    //the inverse of encode(), in place
+    void decode(std::span<hop_chunk> out) {
+        if(mode != channel_mode::mid_side) return;
+        for(u32 i = 0; i < hop_size; i++) {
+            const f32 m = out[0][i], s = out[1][i];
+            out[0][i] = m + s;
+            out[1][i] = m - s;
+        }
+    }
+
+    //slides a hop of every channel into the analysis windows, without transforming it
+    void skip(std::span<const hop_chunk> in) {
+        in = encode(in);
+        for(u16 c = 0; c < n_channels; c++)
+            vocoders[c]->analysis_state().skip(in[c]);
+    }
+
+    //the phases and overlap-add start over; the analysis windows are kept up to date by skip()
+    void restart() {
+        for(auto& v : vocoders) {
+            v->modification_state().reset();
+            v->synthesis_state().reset();
+        }
+        silence.reset();
+    }
+public:
+    //processes any number of interleaved frames; out must be as long as in (and may be the same memory)
+    void process(std::span<const f32> in, std::span<f32> out) {
+        reblocker.process(in, out, [this](std::span<const hop_chunk> i, std::span<hop_chunk> o) { process_hop(i, o); });
+    }
+};
+
+#endif //MULTICHANNEL_VOCODER_HPP
@@ -0,0 +1,269 @@
+#include "offline.hpp"
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <scluk/modern_print.hpp>
+#include "audio_params.hpp"
+#include "any_vocoder.hpp"
+
+namespace offline {
+    namespace {
+        dft::window_type parse_window(std::string_view name) {
+            for(dft::window_type t : dft::window_types)
+                if(name == dft::window_name(t))
+                    return t;
+            throw std::runtime_error("unknown window: " + std::string(name));
+        }
+
+        //a value out of the range of T is as bad as one that isn't a number, rather than one to cast into range
+        template<typename T>
+        T parse_number(std::string_view opt, const char* arg) {
+            using limits = std::numeric_limits<T>;
+            std::size_t used = 0;
+            bool in_range = false;
+            T v{};
+            try {
+                if constexpr(std::is_floating_point_v<T>) {
+                    const f64 d = std::stod(arg, &used);
+                    in_range = std::abs(d) <= f64(limits::max());
+                    v = T(d);
+                } else if constexpr(std::is_signed_v<T>) {
+                    const long long i = std::stoll(arg, &used);
+                    in_range = i >= limits::min() && i <= limits::max();
+                    v = T(i);
+                } else {
+                    //stoull takes "-1" for the largest unsigned long long
+                    const unsigned long long u = std::stoull(arg, &used);
+                    in_range = u <= limits::max() && std::string_view(arg).find('-') == std::string_view::npos;
+                    v = T(u);
+                }
+            } catch(const std::exception&) { used = 0; }
+            if(!arg[0] || arg[used] || !in_range)
+                throw std::runtime_error("bad value for " + std::string(opt) + ": " + arg);
+            return v;
+        }
+
+        //SEMITONES or SEMITONES:GAIN
+        harmony_voice parse_voice(std::string_view opt, const char* arg) {
+            const std::string s = arg;
+            const std::size_t colon = s.find(':');
+            harmony_voice v;
+            v.semitones = parse_number<f32>(opt, s.substr(0, colon).c_str());
+            if(colon != std::string::npos) v.gain = parse_number<f32>(opt, s.substr(colon + 1).c_str());
+            return v;
+        }
+
+        //a file, or sine or sine:HZ
+        void parse_simulation_source(const char* arg, portaudio::simulation& sim) {
+            const std::string_view s = arg;
+            if(s == "sine") return;
+            if(s.starts_with("sine:")) sim.sine_hz = parse_number<f32>("--simulate", arg + 5);
+            else sim.input = std::filesystem::absolute(arg);
+        }
+
+        //writes the frames of interleaved after the first to_skip ones, and takes the skipped frames off to_skip
+        void write_skipping(file::audio_writer& writer, std::span<const f32> interleaved, u16 channels, u64& to_skip) {
+            const u64 skip = std::min<u64>(to_skip, interleaved.size() / channels);
+            to_skip -= skip;
+            writer.write(interleaved.subspan(skip * channels));
+        }
+    }
+
+    const char* usage() {
+        return "usage: out [-i INPUT -o OUTPUT [-p SEMITONES] [-w hann|hamming|blackman-harris|sqrt-hann]\n"
+               "            [--rate HZ] [--channels N] [--block FRAMES] [--mid-side] [-j THREADS]]\n"
+               "       out --batch -i INPUT [-i INPUT...] -o OUTPUT_DIR [-j THREADS] [--chunk SECONDS] [...]\n"
+               "       out [--rate HZ] [--channels N] [--mid-side] [--pipelined]\n"
+               "every mode takes [--win 256|512|1024|2048|4096|8192] [--overlap 2|4|8], the fft size and how many\n"
+               "windows overlap (bigger windows resolve lower frequencies, at the cost of latency), and\n"
+               "[--voice SEMITONES[:GAIN]...]: with voices the output is a harmony of copies of the input shifted by\n"
+               "each SEMITONES (and by -p, or the pitch of the gui, on top) and scaled by each GAIN, and [--gate PEAK]:\n"
+               "input peaking at or below PEAK is silence, whose processing is skipped (0, the default, only gates\n"
+               "digital silence; a negative PEAK turns the gate off).\n"
+               "[--stats SECONDS] times every stage of the vocoder and prints the percentiles every SECONDS (or once at\n"
+               "the end of a file), [--trace FILE] writes the latest of those timings to FILE as a chrome trace json\n"
+               "(open it in chrome://tracing or ui.perfetto.dev). Batch mode doesn't take either.\n"
+               "Instead of the audio device and the gui, the interactive mode can run headless on a simulated device\n"
+               "(--simulate FILE|sine[:HZ], looped) that calls back every [--sim-buffer FRAMES] (256) in real time, up\n"
+               "to [--sim-jitter US] late, losing a buffer with a chance of [--sim-overruns P], and writes what it\n"
+               "plays to [--sim-out FILE], for [--sim-seconds S] (until interrupted by default).\n"
+               "[--realtime] gives the interactive processing thread SCHED_FIFO priority [--rt-priority N] (70), pins\n"
+               "it to [--rt-cpu N], locks and prefaults all memory and flushes denormals to zero, warning about\n"
+               "whatever the privileges of the process don't allow.\n"
+               "Without -i/-o the interactive gui starts, processing the input of the audio device live, optionally\n"
+               "with the stages of the vocoder pipelined across three threads (--pipelined, a hop of latency each).\n"
+               "With -i/-o the input (a wav file, or headerless float32 samples described by --rate and --channels) is\n"
+               "pitch shifted by SEMITONES into OUTPUT (a float32 wav file if its name ends in .wav, headerless float32\n"
+               "otherwise), every channel on its own, or stereo as phase locked mid and side with --mid-side.\n"
+               "With --batch every input file and every .wav/.raw/.f32 file under every input directory goes to\n"
+               "OUTPUT_DIR, on all cores";
+    }
+
+    std::unique_ptr<any_vocoder> vocoder_for(const options& opts, u16 channels, u32 threads) {
+        std::unique_ptr<any_vocoder> vocoder = opts.voices.empty()
+            ? make_vocoder(opts.win, opts.overlap, channels, opts.mode_for(channels), threads, opts.pipelined)
+            : make_harmonizer(opts.win, opts.overlap, channels, opts.voices);
+        vocoder->set_gate(opts.gate);
+        return vocoder;
+    }
+
+    std::unique_ptr<telemetry::audio_stats> stats_for(const options& opts, u32 rate, u32 hop) {
+        //a few seconds of the hops of a few channels
+        constexpr u64 trace_events = 1 << 18;
+        if(opts.stats_period <= 0. && opts.trace.empty())
+            return nullptr;
+        return std::make_unique<telemetry::audio_stats>(rate, hop, opts.trace.empty() ? 0 : trace_events);
+    }
+
+    options parse_cli(int argc, char** argv) {
+        options opts;
+        //the interactive mode has its own defaults for these
+        bool rate_given = false, channels_given = false, win_given = false, overlap_given = false;
+        for(int i = 1; i < argc; i++) {
+            const std::string_view opt = argv[i];
+            if(opt == "-h" || opt == "--help") {
+                opts.help = true;
+                return opts;
+            }
+            if(opt == "--batch") {
+                opts.batch = true;
+                continue;
+            }
+            if(opt == "--mid-side") {
+                opts.mid_side = true;
+                continue;
+            }
+            if(opt == "--pipelined") {
+                opts.pipelined = true;
+                continue;
+            }
+            if(opt == "--realtime") {
+                if(!opts.realtime) opts.realtime.emplace();
+                continue;
+            }
+            if(i + 1 >= argc)
+                throw std::runtime_error("missing value for " + std::string(opt));
+            const char* val = argv[++i];
+
+            if(opt == "-i" || opt == "--in") opts.in.push_back(std::filesystem::absolute(val));
+            else if(opt == "-o" || opt == "--out") opts.out = std::filesystem::absolute(val);
+            else if(opt == "-p" || opt == "--pitch") opts.semitones = parse_number<f32>(opt, val);
+            else if(opt == "-w" || opt == "--window") opts.window = parse_window(val);
+            else if(opt == "--rate") opts.raw_format.rate = parse_number<u32>(opt, val), rate_given = true;
+            else if(opt == "--channels") opts.raw_format.channels = parse_number<u16>(opt, val), channels_given = true;
+            else if(opt == "--win") opts.win = parse_number<u32>(opt, val), win_given = true;
+            else if(opt == "--overlap") opts.overlap = parse_number<u32>(opt, val), overlap_given = true;
+            else if(opt == "--block") opts.block_frames = std::max<u64>(parse_number<u64>(opt, val), 1);
+            else if(opt == "-j" || opt == "--jobs") opts.threads = std::max<u32>(parse_number<u32>(opt, val), 1);
+            else if(opt == "--chunk") opts.chunk_seconds = parse_number<f64>(opt, val);
+            else if(opt == "--voice") opts.voices.push_back(parse_voice(opt, val));
+            else if(opt == "--gate") opts.gate = parse_number<f32>(opt, val);
+            else if(opt == "--stats") opts.stats_period = parse_number<f64>(opt, val);
+            else if(opt == "--trace") opts.trace = std::filesystem::absolute(val);
+            else if(opt == "--rt-priority" || opt == "--rt-cpu") {
+                //either asks for the realtime mode
+                parallel::realtime_options& rt = opts.realtime ? *opts.realtime : opts.realtime.emplace();
+                if(opt == "--rt-priority") rt.priority = parse_number<i32>(opt, val);
+                else rt.cpu = parse_number<u32>(opt, val);
+            }
+            else if(opt == "--simulate" || opt.starts_with("--sim-")) {
+                //any of these asks for the simulation
+                portaudio::simulation& sim = opts.simulation ? *opts.simulation : opts.simulation.emplace();
+                if(opt == "--simulate") parse_simulation_source(val, sim);
+                else if(opt == "--sim-out") sim.output = std::filesystem::absolute(val);
+                else if(opt == "--sim-buffer") sim.buffer_frames = std::max<u32>(parse_number<u32>(opt, val), 1);
+                else if(opt == "--sim-jitter") sim.jitter_us = parse_number<f64>(opt, val);
+                else if(opt == "--sim-overruns") sim.overrun_chance = std::clamp(parse_number<f64>(opt, val), 0., 1.);
+                else if(opt == "--sim-seconds") opts.sim_seconds = parse_number<f64>(opt, val);
+                else throw std::runtime_error("unknown option: " + std::string(opt));
+            }
+            else throw std::runtime_error("unknown option: " + std::string(opt));
+        }
+        if(std::ranges::find(any_vocoder::window_sizes, opts.win) == any_vocoder::window_sizes.end())
+            throw std::runtime_error("unsupported window size: " + std::to_string(opts.win));
+        if(std::ranges::find(any_vocoder::overlaps, opts.overlap) == any_vocoder::overlaps.end())
+            throw std::runtime_error("unsupported overlap: " + std::to_string(opts.overlap));
+        if(!opts.voices.empty() && (opts.mid_side || opts.pipelined))
+            throw std::runtime_error("voices can't be combined with --mid-side or --pipelined");
+        if(opts.batch && (opts.stats_period > 0. || !opts.trace.empty()))
+            throw std::runtime_error("batch mode can't be timed with --stats or --trace");
+
+        if(opts.in.empty() && opts.out.empty() && !opts.batch) {
+            opts.interactive = true;
+            if(!rate_given) opts.raw_format.rate = audio::rate;
+            if(!channels_given) opts.raw_format.channels = audio::channels;
+            if(!win_given) opts.win = u32(audio::ft_win);
+            if(!overlap_given) opts.overlap = u32(audio::ift_overlap);
+            //what a portaudio stream takes
+            if(opts.raw_format.channels > 255)
+                throw std::runtime_error("too many channels for the audio device: " + std::to_string(opts.raw_format.channels));
+            return opts;
+        }
+        if(opts.simulation)
+            throw std::runtime_error("a simulated device only stands in for the one of the interactive mode");
+        if(opts.realtime)
+            throw std::runtime_error("the realtime mode is only for the interactive mode");
+        if(opts.in.empty() || opts.out.empty())
+            throw std::runtime_error("both an input (-i) and an output (-o) are needed");
+        if(opts.in.size() > 1 && !opts.batch)
+            throw std::runtime_error("several inputs need --batch");
+        return opts;
+    }
+
+    void run(const options& opts) {
+        using namespace scluk::language_extension;
+        using clk = std::chrono::steady_clock;
+        const auto start = clk::now();
+
+        const file::audio_reader reader(opts.in.front(), opts.raw_format);
+        const file::audio_format fmt = reader.format();
+        const u16 channels = fmt.channels;
+        file::audio_writer writer(opts.out, fmt.rate, channels, file::is_wav_path(opts.out));
+
+        const std::unique_ptr<any_vocoder> vocoder = vocoder_for(opts, channels, opts.threads);
+        vocoder->set_pitch_semitones(opts.semitones);
+        vocoder->set_window(opts.window);
+        const std::unique_ptr<telemetry::audio_stats> stats = stats_for(opts, fmt.rate, vocoder->hop_size());
+        vocoder->set_stats(stats.get());
+
+        const u64 block = opts.block_frames;
+        std::vector<f32> interleaved(block * channels), processed(block * channels);
+        auto process_block = [&](u64 n) {
+            vocoder->process(std::span<const f32>(interleaved.data(), n * channels), std::span<f32>(processed.data(), n * channels));
+        };
+
+        //the first latency frames out of the vocoders come from before the start of the file
+        u64 to_skip = vocoder->latency();
+        for(u64 first = 0; first < reader.frames(); first += block) {
+            const u64 n = std::min(block, reader.frames() - first);
+            reader.read(first, n, interleaved);
+            process_block(n);
+            write_skipping(writer, std::span<const f32>(processed.data(), n * channels), channels, to_skip);
+            reader.release_before(first + n);
+        }
+        //push silence through to get the tail out
+        std::fill(interleaved.begin(), interleaved.end(), 0.f);
+        for(u64 tail = vocoder->latency(); tail;) {
+            const u64 n = std::min(block, tail);
+            process_block(n);
+            write_skipping(writer, std::span<const f32>(processed.data(), n * channels), channels, to_skip);
+            tail -= n;
+        }
+        writer.close();
+
+        const f64 wall_s = std::chrono::duration<f64>(clk::now() - start).count();
+        const f64 audio_s = f64(reader.frames()) / f64(fmt.rate);
+        out("%: % frames x % channels at % Hz (% s of audio), window % overlap %, in % s on % threads, % x realtime",
+            opts.out.string(), reader.frames(), channels, fmt.rate, audio_s, opts.win, opts.overlap, wall_s, vocoder->threads(),
+            audio_s / wall_s);
+        if(stats && opts.stats_period > 0.)
+            out("%", telemetry::report(*stats));
+        if(stats && !opts.trace.empty())
+            telemetry::write_chrome_trace(*stats, opts.trace);
+    }
+}
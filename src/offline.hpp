@@ -0,0 +1,92 @@
+#ifndef OFFLINE_HPP
+#define OFFLINE_HPP
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <scluk/aliases.hpp>
+#include "dft/window.hpp"
+#include "file/audio_file.hpp"
+#include "any_vocoder.hpp"
+#include "telemetry/stats.hpp"
+#include "portaudio/simulated_device.hpp"
+#include "parallel/realtime.hpp"
+
+// headless mode: pitch shift a file into another one as fast as the cpu allows, without the gui or any audio device
+namespace offline {
+    using namespace scluk::type_aliases;
+
+    struct options {
+        //a single input file, or in batch mode any number of files and directories (searched recursively)
+        std::vector<std::filesystem::path> in;
+        //the output file, or in batch mode the directory the outputs go to
+        std::filesystem::path out;
+        f32 semitones = 0.f;
+        dft::window_type window = dft::window_type::hann;
+        //format of headerless input files; wav files carry their own
+        file::audio_format raw_format;
+        //frames read, processed and written at a time
+        u64 block_frames = 1 << 16;
+        //fft size and overlap of the vocoder, out of any_vocoder::window_sizes and any_vocoder::overlaps; unless given,
+        //the interactive mode takes audio::ft_win and audio::ift_overlap instead
+        u32 win = 1024, overlap = 4;
+        //phase locked mid/side processing of stereo files (files with any other channel count are unaffected)
+        bool mid_side = false;
+        //only print the usage
+        bool help = false;
+        //neither input nor output given: process the input of the audio device live, with the gui. raw_format then
+        //describes the device stream
+        bool interactive = false;
+        //interactive mode: run the stages of the vocoder on threads of their own (see pipelined_vocoder.hpp)
+        bool pipelined = false;
+        //hops peaking at or below this are silence, which the vocoder skips once it has been going on for a window
+        //(see multichannel_vocoder::set_gate()); negative turns the gate off
+        f32 gate = 0.f;
+        //if any, the output is the mix of these voices (see harmonizer.hpp), all transposed by semitones
+        std::vector<harmony_voice> voices;
+        //time every stage of the vocoder (see telemetry/stats.hpp) and print the percentiles every stats_period seconds
+        //(file mode: once, at the end); 0 doesn't time anything
+        f64 stats_period = 0.;
+        //if not empty, where a chrome trace of the latest timed stages goes once done (times the stages on its own)
+        std::filesystem::path trace;
+        //interactive mode: run on a simulated audio device instead of a real one, headless (without the gui), for
+        //sim_seconds seconds (0 for until interrupted)
+        std::optional<portaudio::simulation> simulation;
+        f64 sim_seconds = 0.;
+        //interactive mode: make the processing thread realtime (see parallel::make_realtime()). The stages of a pipeline
+        //run on threads started before, which only get the memory locking
+        std::optional<parallel::realtime_options> realtime;
+
+        bool batch = false;
+        //worker threads: in batch mode they take files and chunks of files, otherwise the channels of the file
+        u32 threads = std::max(std::thread::hardware_concurrency(), 1u);
+        //batch mode: length of the chunks long files are split into
+        f64 chunk_seconds = 30.;
+
+        channel_mode mode_for(u16 channels) const {
+            return mid_side && channels == 2 ? channel_mode::mid_side : channel_mode::independent;
+        }
+    };
+
+    // parses the command line, throwing on bad arguments. Paths are made absolute right away, since main changes the
+    // working directory later
+    options parse_cli(int argc, char** argv);
+
+    const char* usage();
+
+    // the vocoder, or the harmonizer if there are voices, that opts asks for, for a stream of the given channels
+    std::unique_ptr<any_vocoder> vocoder_for(const options& opts, u16 channels, u32 threads);
+
+    // processes opts.in[0] into opts.out, every channel through its own vocoder (channels in parallel when there are
+    // enough of them), and prints how fast it went. The output has the same length as the input and is aligned to it
+    // (the latency of the vocoder is compensated)
+    void run(const options& opts);
+
+    // the stats opts asks for, for a stream of the given rate and hop size, or none
+    std::unique_ptr<telemetry::audio_stats> stats_for(const options& opts, u32 rate, u32 hop);
+}
+
+#endif //OFFLINE_HPP
@@ -0,0 +1,21 @@
+#ifndef PARALLEL_AFFINITY_HPP
+#define PARALLEL_AFFINITY_HPP
+
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+#include <scluk/aliases.hpp>
+
+namespace parallel {
+    using namespace scluk::type_aliases;
+
+    // restricts a thread to a single cpu (modulo the cpus there are); returns false if the os refused
+    inline bool pin_thread(std::thread::native_handle_type thread, u32 cpu) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu % std::max(std::thread::hardware_concurrency(), 1u), &set);
+        return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+    }
+}
+
+#endif //PARALLEL_AFFINITY_HPP
@@ -0,0 +1,78 @@
+#ifndef PARALLEL_FORK_JOIN_HPP
+#define PARALLEL_FORK_JOIN_HPP
+
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <scluk/aliases.hpp>
+
+namespace parallel {
+    using namespace scluk::type_aliases;
+
+    // a fixed team of threads that runs one job split into size() parts whenever its owner asks: the owner runs part 0
+    // itself and returns once every part is done. Meant for short jobs repeated at a high rate (a hop of every channel
+    // of a stream), so the threads spin for a little while before going to sleep, and running a job never allocates.
+    // Only the owner may call run(); jobs must not throw.
+    class fork_join {
+        //bumped by the owner to start a job, and once more by the destructor to make the threads leave
+        std::atomic<u32> epoch = 0;
+        //parts finished in the current job, not counting the owner's
+        std::atomic<u32> done = 0;
+        bool exiting = false;
+        void* job_ctx = nullptr;
+        void (*job_fn)(void*, u32) = nullptr;
+        std::vector<std::jthread> threads;
+
+        //a few microseconds of polling, then a futex wait
+        template<typename T>
+        static void wait_while_equal(const std::atomic<T>& a, T v) {
+            for(u32 i = 0; i < 4096; i++)
+                if(a.load(std::memory_order_acquire) != v) return;
+            while(a.load(std::memory_order_acquire) == v)
+                a.wait(v, std::memory_order_acquire);
+        }
+
+        void work(u32 part) {
+            for(u32 seen = 0;;) {
+                wait_while_equal(epoch, seen);
+                seen = epoch.load(std::memory_order_acquire);
+                if(exiting) return;
+                job_fn(job_ctx, part);
+                done.fetch_add(1, std::memory_order_acq_rel);
+                done.notify_one();
+            }
+        }
+    public:
+        explicit fork_join(u32 parts) {
+            for(u32 p = 1; p < std::max(parts, 1u); p++)
+                threads.emplace_back(&fork_join::work, this, p);
+        }
+        fork_join(const fork_join&) = delete;
+        fork_join& operator=(const fork_join&) = delete;
+        ~fork_join() {
+            exiting = true;
+            epoch.fetch_add(1, std::memory_order_acq_rel);
+            epoch.notify_all();
+        }
+
+        u32 size() const { return u32(threads.size()) + 1; }
+
+        // calls job(part) once for every part in [0, size()), part 0 on the calling thread
+        template<typename F>
+        void run(F& job) {
+            if(threads.empty()) return job(0u);
+            job_ctx = &job;
+            job_fn = [](void* ctx, u32 part) { (*static_cast<F*>(ctx))(part); };
+            done.store(0, std::memory_order_relaxed);
+            epoch.fetch_add(1, std::memory_order_acq_rel);
+            epoch.notify_all();
+
+            job(0u);
+            for(u32 d; (d = done.load(std::memory_order_acquire)) != threads.size();)
+                wait_while_equal(done, d);
+        }
+    };
+}
+
+#endif //PARALLEL_FORK_JOIN_HPP
@@ -0,0 +1,107 @@
+#ifndef PARALLEL_REALTIME_HPP
+#define PARALLEL_REALTIME_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+#include <scluk/aliases.hpp>
+#include "affinity.hpp"
+
+// what it takes for a thread to meet audio deadlines on a busy machine: a realtime scheduling class, a cpu of its own,
+// no page faults and no denormal slowdowns. Everything here is best effort, since most of it needs privileges
+namespace parallel {
+    using namespace scluk::type_aliases;
+
+    struct realtime_options {
+        //SCHED_FIFO priority, from 1 to 99; kept below the 99 of the kernel's own watchdogs by default
+        i32 priority = 70;
+        //the cpu the thread is pinned to, if any
+        std::optional<u32> cpu;
+    };
+
+    // SCHED_FIFO at priority (or at the highest one RLIMIT_RTPRIO allows, if that's lower) for the calling thread;
+    // returns 0 or the error
+    inline int set_fifo_priority(i32 priority) {
+        sched_param param {};
+        param.sched_priority = std::clamp(priority, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        rlimit limit;
+        if(err == EPERM && getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur > 0 && rlim_t(param.sched_priority) > limit.rlim_cur) {
+            param.sched_priority = i32(limit.rlim_cur);
+            err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        }
+        return err;
+    }
+
+    // locks every page of the process in memory, present and future, faulting them all in now, and keeps malloc from
+    // giving memory back to the os or mapping big blocks afresh (either of which would fault again later); returns 0
+    // or the error
+    inline int lock_memory() {
+        if(mlockall(MCL_CURRENT | MCL_FUTURE))
+            return errno;
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+        return 0;
+    }
+
+    // touches stack_bytes of stack below the caller, so that the calls it makes later find their frames mapped (and,
+    // once memory is locked, kept)
+    template<u64 stack_bytes = 256 << 10>
+    [[gnu::noinline]] void prefault_stack() {
+        u8 stack[stack_bytes];
+        std::memset(stack, 0, stack_bytes);
+        //as if the stack was read, so that the writes aren't optimized away
+        asm volatile("" :: "r"(stack) : "memory");
+    }
+
+    // flush-to-zero and denormals-are-zero for the calling thread (threads it starts later inherit them): denormal
+    // floats, like the tails of decaying overlap-adds, are treated as 0 instead of taking the slow path of the fpu.
+    // Returns false where it isn't supported
+    inline bool flush_denormals() {
+        #if defined(__SSE__)
+        //FTZ and DAZ (the latter is missing from the oldest sse cpus, which ignore it)
+        _mm_setcsr(_mm_getcsr() | 0x8040);
+        return true;
+        #elif defined(__aarch64__)
+        u64 fpcr;
+        asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+        asm volatile("msr fpcr, %0" :: "r"(fpcr | (u64(1) << 24)));
+        return true;
+        #else
+        return false;
+        #endif
+    }
+
+    // makes the calling thread as realtime as the os allows: every step that fails is skipped, and explained in the
+    // warnings returned. Memory locking covers the whole process and the rest only the calling thread (and the threads
+    // it starts afterwards), so it is best called once everything the thread uses has been allocated
+    inline std::vector<std::string> make_realtime(const realtime_options& opts) {
+        std::vector<std::string> warnings;
+        if(const int err = set_fifo_priority(opts.priority))
+            warnings.push_back(err == EPERM
+                ? "no permission for realtime priority: it needs CAP_SYS_NICE, or an rtprio limit (ulimit -r, /etc/security/limits.conf)"
+                : std::string("can't set realtime priority: ") + std::strerror(err));
+        if(opts.cpu && !pin_thread(pthread_self(), *opts.cpu))
+            warnings.push_back("can't pin to cpu " + std::to_string(*opts.cpu));
+        if(const int err = lock_memory())
+            warnings.push_back(std::string("can't lock memory (") + std::strerror(err) + "): it needs CAP_IPC_LOCK, or a memlock "
+                "limit (ulimit -l) bigger than the process; page faults can still interrupt the audio");
+        prefault_stack();
+        if(!flush_denormals())
+            warnings.push_back("can't flush denormals to zero on this cpu");
+        return warnings;
+    }
+}
+
+#endif //PARALLEL_REALTIME_HPP
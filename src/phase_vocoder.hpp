@@ -0,0 +1,230 @@
+#ifndef PHASE_VOCODER_HPP
+#define PHASE_VOCODER_HPP
+
+#include <array>
+#include <algorithm>
+#include <span>
+#include <scluk/aliases.hpp>
+#include <scluk/array.hpp>
+#include <scluk/math.hpp>
+#include "dft/sliding_dft.hpp"
+#include "dft/window.hpp"
+#include "dft/overlap_add.hpp"
+#include "dft/polar.hpp"
+#include "hop_reblocker.hpp"
+
+using namespace scluk::type_aliases;
+
+// pitch shifting phase vocoder over a mono stream, with no ties to any audio device or gui: windowed fft of the last
+// win samples every win/overlap samples, phase adjustment, pitch scaled ifft, overlap-add. Every buffer is allocated
+// by the constructor, so processing never allocates (once the ifft scratch has seen the largest pitch factor used).
+// The three steps are separate stages that only share the frame they hand each other, so that they can also run on
+// different threads (see pipelined_vocoder.hpp).
+template<u32 win, u32 overlap>
+class phase_vocoder {
+public:
+    static constexpr u32 window_size = win;
+    static constexpr u32 hop_size = win / overlap;
+    using sliding_dft = dft::sliding_dft<f32, win>;
+    using dft_array = typename sliding_dft::dft_array;
+    static constexpr u32 bins = dft_array::bins;
+    using hop_chunk = std::array<f32, hop_size>;
+    static_assert(win % overlap == 0, "the window size must be a multiple of the overlap factor");
+
+    //what a hop is processed with; it travels along with the frame, so every stage of a hop agrees on it
+    struct hop_params {
+        f32 pitch_factor = 1.f;
+        //the analysis window; synthesis uses the window that makes the pair overlap-add to 1 (see
+        //dft::synthesis_window_table())
+        dft::window_type window = dft::window_type::hann;
+    };
+
+    //one hop of spectrum in polar form, as it goes from a stage to the next: the modification stage replaces the
+    //phases of the analysis with the adjusted ones
+    struct frame {
+        std::array<f32, bins> magnitude, phase;
+        hop_params params;
+    };
+
+    //windowed fft of the latest window, into a frame
+    class analysis_stage {
+        sliding_dft dft;
+        //hops were skipped since the last transform
+        bool stale = false;
+    public:
+        void reset() {
+            dft.reset();
+            stale = false;
+        }
+        //spectrum of the last analyzed window
+        const sliding_dft& spectrum() const { return dft; }
+
+        void run(const hop_chunk& in, const hop_params& params, frame& out) {
+            dft.set_window(params.window);
+            dft.push_frames_fft(in);
+            dft::to_polar(dft.real_data(), dft.imag_data(), out.magnitude.data(), out.phase.data(), bins);
+            out.params = params;
+            stale = false;
+        }
+
+        //takes a hop in without transforming it, so that the window is up to date whenever run() is called again
+        void skip(const hop_chunk& in) {
+            dft.enqueue_frames(in);
+            stale = true;
+        }
+        //brings spectrum() up to date after skip()
+        void refresh(const hop_params& params) {
+            if(!stale) return;
+            dft.set_window(params.window);
+            dft.transform();
+            stale = false;
+        }
+    };
+
+    //phase adjustment to avoid artifacts (this is what makes this a phase vocoder)
+    class modification_stage {
+        //the phases of the previous hop, and the adjusted phases they were turned into
+        std::array<f32, bins> old_phase, adjusted_phase;
+        //the first hop has no previous phases to advance from
+        bool first_hop = true;
+
+        void advance_phases(const frame& f) {
+            using scluk::math::pi;
+            if(first_hop) {
+                adjusted_phase = f.phase;
+                first_hop = false;
+            } else for(u32 i = 0; i < bins; i++) {
+                //integer division allows me to automatically floor without additional cost
+                const f32 unwrap_addend = 2.f*pi * f32(i / overlap);
+
+                const f32 raw_p_delta = f.phase[i] - old_phase[i];
+                const f32 mod_p_delta = raw_p_delta + std::signbit(raw_p_delta) * 2.f*pi;
+
+                const f32 adj_p_delta = (unwrap_addend + mod_p_delta) * f.params.pitch_factor;
+                adjusted_phase[i] = dft::wrap_phase(adjusted_phase[i] + adj_p_delta);
+            }
+            old_phase = f.phase;
+        }
+    public:
+        void reset() { first_hop = true; }
+
+        void run(frame& f) {
+            advance_phases(f);
+            f.phase = adjusted_phase;
+        }
+
+        //run() for two stages working in lockstep on related signals (e.g. the mid and side of a stereo pair): in
+        //every bin the frame with the bigger magnitude advances its phase as usual, and the other one is rotated by
+        //the same angle, so the phase difference between the two (i.e. the stereo image) is kept instead of drifting
+        static void run_locked(modification_stage& a, frame& fa, modification_stage& b, frame& fb) {
+            a.advance_phases(fa);
+            b.advance_phases(fb);
+            for(u32 i = 0; i < bins; i++) {
+                const bool a_leads = fa.magnitude[i] >= fb.magnitude[i];
+                modification_stage& leader = a_leads ? a : b;
+                modification_stage& follower = a_leads ? b : a;
+                const frame& leader_frame = a_leads ? fa : fb;
+                const frame& follower_frame = a_leads ? fb : fa;
+                follower.adjusted_phase[i] = dft::wrap_phase(follower_frame.phase[i] + leader.adjusted_phase[i] - leader_frame.phase[i]);
+            }
+            fa.phase = a.adjusted_phase;
+            fb.phase = b.adjusted_phase;
+        }
+    };
+
+    //pitch scaled ifft of a frame, overlap-added into the output with the synthesis window applied on the way
+    class synthesis_stage {
+        using bin_array = scluk::heap_array<f32, bins>;
+        bin_array re, im;
+        dft_array rect;
+        typename dft_array::ifft_workspace ifft_ws;
+        //the latest ift, and the overlap-add of the windowed iffts so far
+        scluk::heap_array<f32, win> ift;
+        dft::overlap_add<f32, win, overlap> ola;
+        //the analysis window of the latest frame, which picks the synthesis window
+        dft::window_type window = dft::window_type::hann;
+    public:
+        void reset() { ola.reset(); }
+        //looks up the ifft plan for frames at pitch_factor ahead of the first of them
+        void prepare(f32 pitch_factor) { ifft_ws.prepare(pitch_factor); }
+
+        void run(const frame& f, hop_chunk& out) {
+            transform(f);
+            overlap_add(out);
+        }
+
+        //the two halves of run(), for callers that time them separately: the ifft of a frame, and its overlap-add
+        //into a hop of output
+        void transform(const frame& f) {
+            window = f.params.window;
+            dft::from_polar(f.magnitude.data(), f.phase.data(), &re[0], &im[0], bins);
+            for(u32 i = 0; i < bins; i++)
+                rect[i] = { re[i], im[i] };
+            rect.ifft(f.params.pitch_factor, std::span<f32>(&ift[0], win), ifft_ws);
+        }
+        void overlap_add(hop_chunk& out) {
+            ola.add(&ift[0], dft::synthesis_window_table<f32, win, overlap>(window).data());
+            ola.emit(out.data());
+        }
+    };
+private:
+    analysis_stage analysis;
+    modification_stage modification;
+    synthesis_stage synthesis;
+    frame current;
+    hop_params params;
+
+    hop_reblocker<hop_size> reblocker { 1 };
+public:
+    explicit phase_vocoder(f32 pitch_factor = 1.f) { set_pitch_factor(pitch_factor); }
+
+    void reset() {
+        analysis.reset();
+        modification.reset();
+        synthesis.reset();
+        reblocker.reset();
+    }
+
+    //the ifft plan for a new pitch is built here rather than by the first hop at it
+    void set_pitch_factor(f32 f) {
+        params.pitch_factor = f;
+        synthesis.prepare(f);
+    }
+    void set_pitch_semitones(f32 semitones) { set_pitch_factor(std::pow(2.f, semitones / 12.f)); }
+    f32 get_pitch_factor() const { return params.pitch_factor; }
+
+    void set_window(dft::window_type t) { params.window = t; }
+    dft::window_type get_window() const { return params.window; }
+
+    const hop_params& get_params() const { return params; }
+
+    //spectrum of the last analyzed window
+    const sliding_dft& spectrum() const { return analysis.spectrum(); }
+
+    //samples between an input sample entering process() and the corresponding output: a hop of re-blocking, plus
+    //the window minus the hop the newest frame contributes to right away
+    static constexpr u32 latency() { return win; }
+
+    //the three stages of a hop, for callers that want to run them separately
+    void analyze(const hop_chunk& in) { analysis.run(in, params, current); }
+    void modify() { modification.run(current); }
+    void synthesize(hop_chunk& out) { synthesis.run(current, out); }
+
+    //the stages themselves, for callers that keep the frames between them
+    analysis_stage& analysis_state() { return analysis; }
+    modification_stage& modification_state() { return modification; }
+    synthesis_stage& synthesis_state() { return synthesis; }
+
+    void process_hop(const hop_chunk& in, hop_chunk& out) {
+        analyze(in);
+        modify();
+        synthesize(out);
+    }
+
+    //processes any number of samples; out must be as long as in (and may be the same memory)
+    void process(std::span<const f32> in, std::span<f32> out) {
+        reblocker.process(in, out, [this](std::span<const hop_chunk> i, std::span<hop_chunk> o) { process_hop(i[0], o[0]); });
+    }
+};
+
+#endif //PHASE_VOCODER_HPP
@@ -0,0 +1,148 @@
+#ifndef PIPELINED_VOCODER_HPP
+#define PIPELINED_VOCODER_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+#include "multichannel_vocoder.hpp"
+#include "lockfree/spsc_ring.hpp"
+#include "parallel/affinity.hpp"
+
+// runs the analysis, modification and synthesis stages of a multichannel_vocoder on three threads of their own,
+// handing each other the frames of a hop through wait-free queues, so that a hop only needs the slowest stage (rather
+// than all three) to fit in a hop period. The price is latency: a hop comes out `stages` hops after it went in, on top
+// of the latency of the vocoder. The hops and frames live in a fixed set of slots allocated by the constructor; only
+// slot indices go through the queues, so nothing is allocated or copied but the hops themselves.
+template<u32 win, u32 overlap>
+class pipelined_vocoder {
+public:
+    using vocoder = multichannel_vocoder<win, overlap>;
+    using hop_chunk = typename vocoder::hop_chunk;
+    using frame = typename vocoder::frame;
+    static constexpr u32 stages = 3;
+
+    //the latency of the vocoder plus a hop for every stage
+    static constexpr u32 latency() { return vocoder::latency() + stages * vocoder::hop_size; }
+private:
+    //every stage can be busy with a hop while the caller fills the next one
+    static constexpr u32 n_slots = std::bit_ceil(stages + 1);
+
+    struct slot {
+        std::vector<hop_chunk> hops;
+        std::vector<frame> frames;
+        typename vocoder::hop_params params;
+    };
+
+    //a queue of slot indices between two threads; the consumer sleeps on the push count when it finds it empty
+    struct queue {
+        lockfree::spsc_ring<u32, n_slots> ring;
+        std::atomic<u32> pushes = 0;
+
+        void push(u32 s) {
+            ring.push(s);
+            pushes.fetch_add(1, std::memory_order_release);
+            pushes.notify_one();
+        }
+        bool pop(u32& s, const std::atomic<bool>& stop) {
+            for(;;) {
+                const u32 seen = pushes.load(std::memory_order_acquire);
+                if(ring.pop(s)) return true;
+                if(stop.load(std::memory_order_acquire)) return false;
+                pushes.wait(seen, std::memory_order_acquire);
+            }
+        }
+        void wake() {
+            pushes.fetch_add(1, std::memory_order_release);
+            pushes.notify_all();
+        }
+    };
+
+    vocoder& v;
+    std::unique_ptr<slot[]> slots;
+    //slots owned by the caller, and how many of them are on their way through the stages
+    std::array<u32, n_slots> free_slots;
+    u32 n_free = n_slots, in_flight = 0;
+    //the slot of the last hop returned, whose frames stay readable until the next process_hop()
+    u32 last_done = ~0u;
+    queue to_analysis, to_modification, to_synthesis, done;
+    std::atomic<bool> stopping = false;
+    bool pinned = true;
+    std::array<std::jthread, stages> threads;
+
+    void stage_loop(queue& from, queue& to, auto work) {
+        for(u32 s = 0; from.pop(s, stopping);) {
+            work(slots[s]);
+            to.push(s);
+        }
+    }
+public:
+    // v must outlive the pipeline, and must not be used directly while the pipeline exists (but its parameters may
+    // still be set from the thread calling process_hop()). The stage threads are pinned to cpus first_cpu,
+    // first_cpu + 1 and first_cpu + 2 (modulo the cpus there are) if there are more cpus than stages
+    explicit pipelined_vocoder(vocoder& v, u32 first_cpu = 1) : v(v), slots(new slot[n_slots]) {
+        for(u32 i = 0; i < n_slots; i++) {
+            slots[i].hops.resize(v.channels());
+            slots[i].frames.resize(v.channels());
+            free_slots[i] = i;
+        }
+
+        threads[0] = std::jthread([this] {
+            stage_loop(to_analysis, to_modification, [this](slot& s) { this->v.analyze(s.hops, s.params, s.frames); });
+        });
+        threads[1] = std::jthread([this] {
+            stage_loop(to_modification, to_synthesis, [this](slot& s) { this->v.modify(s.frames); });
+        });
+        threads[2] = std::jthread([this] {
+            stage_loop(to_synthesis, done, [this](slot& s) { this->v.synthesize(s.frames, s.hops); });
+        });
+        if(std::thread::hardware_concurrency() > stages)
+            for(u32 i = 0; i < stages; i++)
+                pinned &= parallel::pin_thread(threads[i].native_handle(), first_cpu + i);
+        else pinned = false;
+    }
+    pipelined_vocoder(const pipelined_vocoder&) = delete;
+    pipelined_vocoder& operator=(const pipelined_vocoder&) = delete;
+    ~pipelined_vocoder() {
+        stopping = true;
+        for(queue* q : { &to_analysis, &to_modification, &to_synthesis, &done })
+            q->wake();
+    }
+
+    //whether every stage thread got a cpu of its own
+    bool is_pinned() const { return pinned; }
+
+    // feeds a hop of every channel to the pipeline and returns the output of the hop fed `stages` calls ago (silence
+    // for the first `stages` calls), waiting for it if the stages haven't finished it yet. in and out are planar and
+    // may be the same memory
+    void process_hop(std::span<const hop_chunk> in, std::span<hop_chunk> out) {
+        //the caller holds on to the slot returned last time until now
+        if(last_done != ~0u) {
+            free_slots[n_free++] = last_done;
+            last_done = ~0u;
+        }
+
+        const u32 s = free_slots[--n_free];
+        std::copy(in.begin(), in.end(), slots[s].hops.begin());
+        slots[s].params = v.get_params();
+        to_analysis.push(s);
+
+        if(++in_flight <= stages) {
+            for(hop_chunk& h : out) h.fill(0.f);
+            return;
+        }
+        done.pop(last_done, stopping);
+        in_flight--;
+        std::copy(slots[last_done].hops.begin(), slots[last_done].hops.end(), out.begin());
+    }
+
+    //the frame (after modification) of a channel of the hop returned last, if any; valid until the next process_hop()
+    const frame* last_frame(u16 channel) const {
+        return last_done == ~0u ? nullptr : &slots[last_done].frames[channel];
+    }
+};
+
+#endif //PIPELINED_VOCODER_HPP
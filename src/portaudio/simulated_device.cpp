@@ -0,0 +1,143 @@
+#include "simulated_device.hpp"
+#include <chrono>
+#include <cmath>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../file/audio_file.hpp"
+
+namespace portaudio {
+    namespace {
+        using clk = std::chrono::steady_clock;
+
+        //sleep_until() is only as precise as the scheduler; this sleeps until shortly before t and spins from there
+        void wait_until(clk::time_point t) {
+            using namespace std::chrono_literals;
+            if(t - clk::now() > 500us)
+                std::this_thread::sleep_until(t - 500us);
+            while(clk::now() < t)
+                std::this_thread::yield();
+        }
+    }
+
+    class simulated_device : public backend {
+        const stream_params_t params;
+        const simulation sim;
+        PaStreamCallback* const cb;
+        void* const userdata;
+        //the whole input file, interleaved with the channels of the stream, and where it has been played up to
+        std::vector<f32> source;
+        u64 source_frames = 0, source_pos = 0;
+        f64 sine_phase = 0.;
+        std::optional<file::audio_writer> sink;
+        clk::time_point t0;
+        //frames passed through read() and write(), for streams without a callback
+        u64 frames_read = 0;
+        std::jthread thread;
+
+        //the next frames of input, interleaved
+        void generate(f32* buf, u64 frames) {
+            const u16 chans = params.i_chans;
+            if(source_frames) {
+                for(u64 f = 0; f < frames; f++, source_pos = (source_pos + 1) % source_frames)
+                    std::copy_n(&source[source_pos * chans], chans, buf + f * chans);
+                return;
+            }
+            const f64 step = 2. * std::numbers::pi * f64(sim.sine_hz) / f64(params.rate);
+            for(u64 f = 0; f < frames; f++, sine_phase = std::fmod(sine_phase + step, 2. * std::numbers::pi))
+                std::fill_n(buf + f * chans, chans, .5f * f32(std::sin(sine_phase)));
+        }
+
+        void run(std::stop_token stop) {
+            const u32 frames = params.frames_per_buffer ? params.frames_per_buffer : sim.buffer_frames;
+            const auto period = std::chrono::duration_cast<clk::duration>(std::chrono::duration<f64>(f64(frames) / f64(params.rate)));
+            //how far behind the callback may fall before the device gives up on the buffers in between
+            constexpr u32 max_backlog = 4;
+            std::vector<f32> in(frames * params.i_chans), out(frames * params.o_chans), silence(out.size(), 0.f);
+            std::mt19937 rng(sim.seed);
+            std::uniform_real_distribution<f64> jitter(0., sim.jitter_us);
+            std::bernoulli_distribution overrun(sim.overrun_chance);
+
+            PaStreamCallbackFlags status = 0;
+            clk::time_point deadline = t0;
+            for(u64 n = 0; !stop.stop_requested(); n++) {
+                //the buffer is complete on the device at the deadline, and the callback is woken up some time after
+                deadline += period;
+                wait_until(deadline + std::chrono::duration_cast<clk::duration>(std::chrono::duration<f64, std::micro>(jitter(rng))));
+                generate(in.data(), frames);
+
+                if(clk::now() - deadline > max_backlog * period) {
+                    //the input of the buffers missed meanwhile is gone, and so is the time to play anything for them
+                    const u64 missed = u64((clk::now() - deadline) / period);
+                    for(u64 i = 0; i < missed; i++) {
+                        generate(in.data(), frames);
+                        if(sink) sink->write(silence);
+                    }
+                    deadline += missed * period;
+                    status |= paInputOverflow | paOutputUnderflow;
+                }
+                if(overrun(rng)) {
+                    if(sink) sink->write(silence);
+                    status |= paInputOverflow | paOutputUnderflow;
+                    continue;
+                }
+
+                const auto seconds = [this](clk::time_point t) { return std::chrono::duration<f64>(t - t0).count(); };
+                const PaStreamCallbackTimeInfo time { .inputBufferAdcTime = seconds(deadline - period), .currentTime = seconds(clk::now()),
+                    .outputBufferDacTime = seconds(deadline + period) };
+                const int result = cb(in.data(), out.data(), frames, &time, status, userdata);
+                status = 0;
+                if(sink) sink->write(out);
+                //the output was due to start playing one period after the input was complete
+                if(clk::now() > deadline + period)
+                    status |= paOutputUnderflow;
+                if(result != paContinue) break;
+            }
+        }
+    public:
+        simulated_device(const stream_params_t& params, const simulation& sim, PaStreamCallback* cb, void* userdata)
+            : params(params), sim(sim), cb(cb), userdata(userdata) {
+            if(!sim.input.empty()) {
+                const file::audio_reader reader(sim.input, { .rate = params.rate, .channels = params.i_chans });
+                const u16 file_chans = reader.format().channels;
+                std::vector<f32> samples(reader.frames() * file_chans);
+                reader.read(0, reader.frames(), samples);
+                source_frames = reader.frames();
+                source.resize(source_frames * params.i_chans);
+                for(u64 f = 0; f < source_frames; f++)
+                    for(u16 c = 0; c < params.i_chans; c++)
+                        source[f * params.i_chans + c] = samples[f * file_chans + c % file_chans];
+            }
+            if(!sim.output.empty())
+                sink.emplace(sim.output, params.rate, params.o_chans, file::is_wav_path(sim.output));
+        }
+        ~simulated_device() {
+            //the thread has to stop writing to the sink before it goes
+            if(thread.joinable()) {
+                thread.request_stop();
+                thread.join();
+            }
+        }
+
+        void start() override {
+            t0 = clk::now();
+            if(cb) thread = std::jthread([this](std::stop_token stop) { run(stop); });
+        }
+        //a real device delivers input no faster than it records it
+        void read(f32* buf, u64 frames) override {
+            frames_read += frames;
+            wait_until(t0 + std::chrono::duration_cast<clk::duration>(std::chrono::duration<f64>(f64(frames_read) / f64(params.rate))));
+            generate(buf, frames);
+        }
+        void write(const f32* buf, u64 frames) override {
+            if(sink) sink->write(std::span<const f32>(buf, frames * params.o_chans));
+        }
+    };
+
+    std::unique_ptr<backend> open_simulated_device(const stream_params_t& params, const simulation& sim, PaStreamCallback* cb,
+        void* userdata) {
+        return std::make_unique<simulated_device>(params, sim, cb, userdata);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef PORTAUDIO_SIMULATED_DEVICE_HPP
+#define PORTAUDIO_SIMULATED_DEVICE_HPP
+
+#include <filesystem>
+#include <scluk/aliases.hpp>
+#include "stream_wrapper.hpp"
+
+// a stand-in for an audio device, to run the realtime path where there is no audio hardware. A timer thread calls the
+// callback of the stream one buffer at a time, each when the buffer would have been complete on a real device, with
+// input from a file or a sine and output into a file (or nowhere). It reports what a device would through the status
+// flags of the callback: buffers it loses (injected, or because the callback fell too far behind) come with
+// paInputOverflow, and a callback that returns after its output should have started playing gets paOutputUnderflow
+// on the next one. Streams without a callback read and write in real time.
+namespace portaudio {
+    using namespace scluk::type_aliases;
+
+    struct simulation {
+        //the input: a wav file, or a headerless float32 one in the format of the stream, looped and played at the rate of
+        //the stream whatever its own (a file with fewer channels than the stream repeats them); empty for a sine
+        std::filesystem::path input;
+        f32 sine_hz = 440.f;
+        //where the output goes (a float32 wav file if its name ends in .wav, headerless float32 otherwise), if anywhere
+        std::filesystem::path output;
+        //frames per callback, when the stream leaves it to the device
+        u32 buffer_frames = 256;
+        //every callback is woken up late by up to this, uniformly at random
+        f64 jitter_us = 0.;
+        //chance of every buffer being lost, as if the host had stalled: its input is dropped, its output is silence,
+        //and the next callback is flagged with paInputOverflow and paOutputUnderflow
+        f64 overrun_chance = 0.;
+        u32 seed = 1;
+    };
+}
+
+#endif //PORTAUDIO_SIMULATED_DEVICE_HPP
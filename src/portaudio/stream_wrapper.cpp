@@ -1,3 +1,62 @@
 #include "stream_wrapper.hpp"
+#include <cstdio>
+#include <string>
 
-bool portaudio::is_inited::v = false;
\ No newline at end of file
+bool portaudio::is_inited::v = false;
+
+namespace portaudio {
+    class device_backend : public backend {
+        PaStream* m_stream;
+        static inline void if_err_throw(PaError e, const std::string& msg) {
+            if(e) throw std::runtime_error(msg + Pa_GetErrorText(e));
+        }
+    public:
+        device_backend(const stream_params_t& params, PaStreamCallback* cb, void* userdata) {
+            using namespace std::string_literals;
+
+            std::freopen(params.log, "w", stderr);
+
+            //init pulseaudio if necessary
+            if(!is_inited()) {
+                if_err_throw(Pa_Initialize(), "Pa_Initialize failed:\n");
+                is_inited::v = true;
+            }
+            //find best device; one with name "pulse" or else the one Portaudio thinks is default
+            int num_devices = Pa_GetDeviceCount();
+            if_err_throw(std::min(num_devices, 0), "Pa_GetDeviceCount returned a negative value:\n");
+            int device_index = Pa_GetDefaultInputDevice();
+            for(int i = 0; i < num_devices; i++) {
+                if("pulse"s == Pa_GetDeviceInfo(i)->name) {
+                    device_index = i;
+                    break;
+                }
+            }
+            const PaDeviceInfo* const device_ptr = Pa_GetDeviceInfo(device_index);
+            //open stream
+            PaStreamParameters i_params = { device_index, params.i_chans, paFloat32, device_ptr->defaultLowInputLatency, nullptr };
+            PaStreamParameters o_params = { device_index, params.o_chans, paFloat32, device_ptr->defaultLowOutputLatency, nullptr };
+            if_err_throw(Pa_OpenStream(&m_stream, &i_params, &o_params, f64(params.rate), params.frames_per_buffer, paNoFlag, cb, userdata),
+                "Pa_OpenStream failed:\n");
+        }
+        ~device_backend() {
+            if_err_throw(Pa_CloseStream(m_stream), "Portaudio stream closing error:\n");
+            if_err_throw(Pa_Terminate(), "PortAudio termination error:\n");
+            is_inited::v = false;
+        }
+
+        void start() override {
+            if_err_throw(Pa_StartStream(m_stream), "Portaudio stream starting error:\n");
+        }
+        void read(f32* buf, u64 frames) override {
+            if_err_throw(Pa_ReadStream(m_stream, buf, frames), "Error reading from stream\n");
+        }
+        void write(const f32* buf, u64 frames) override {
+            if_err_throw(Pa_WriteStream(m_stream, buf, frames), "Error writing to stream\n");
+        }
+        PaStream* pa_stream() override { return m_stream; }
+    };
+
+    std::unique_ptr<backend> open_device(const stream_params_t& params, PaStreamCallback* cb, void* userdata) {
+        return std::make_unique<device_backend>(params, cb, userdata);
+    }
+}
@@ -4,6 +4,7 @@
 #include <portaudio.h>
 #include <stdexcept>
 #include <array>
+#include <memory>
 #include <scluk/aliases.hpp>
 #include <scluk/modern_print.hpp>
 
@@ -11,78 +12,64 @@ namespace portaudio {
     using namespace scluk::type_aliases;
     class is_inited {
         static bool v;
-        friend class async_stream;
+        friend class device_backend;
         operator bool(){ return v; }
     };
 
-    class async_stream;
+    struct simulation;
     struct stream_params_t {
         u32 frames_per_buffer = 0, rate = 44100;
         u8 i_chans = 1, o_chans = 1, start = 1;
         const char* log = nullptr;
+        //if set, the stream runs on a simulated device instead of opening a real one (see simulated_device.hpp)
+        const simulation* simulated = nullptr;
     };
 
-    class async_stream {
-    protected:
-        PaStream* m_stream;
-        static inline void if_err_throw(PaError e, const std::string& msg) {
-            if(e) throw std::runtime_error(msg + Pa_GetErrorText(e));
-        }
+    // what a stream runs on: an audio device opened through portaudio, or a simulation of one. Either calls the
+    // callback of the stream (from a thread of its own, once started) or, for streams without one, blocks in read and
+    // write
+    class backend {
     public:
-        async_stream(stream_params_t params, PaStreamCallback* cb, void* userdata = nullptr) {
-            using namespace std::string_literals;
-
-            std::freopen(params.log, "w", stderr);
+        virtual ~backend() = default;
+        virtual void start() = 0;
+        virtual void read(f32* buf, u64 frames) = 0;
+        virtual void write(const f32* buf, u64 frames) = 0;
+        //the portaudio stream behind it, if any
+        virtual PaStream* pa_stream() { return nullptr; }
+    };
 
-            //init pulseaudio if necessary
-            if(!is_inited()) {
-                if_err_throw(Pa_Initialize(), "Pa_Initialize failed:\n");
-                is_inited::v = true;
-            }
-            //find best device; one with name "pulse" or else the one Portaudio thinks is default
-            int num_devices = Pa_GetDeviceCount();
-            if_err_throw(std::min(num_devices, 0), "Pa_GetDeviceCount returned a negative value:\n");
-            int device_index = Pa_GetDefaultInputDevice();
-            for(int i = 0; i < num_devices; i++) {
-                if("pulse"s == Pa_GetDeviceInfo(i)->name) {
-                    device_index = i;
-                    break;
-                }
-            }
-            const PaDeviceInfo* const device_ptr = Pa_GetDeviceInfo(device_index);
-            //open stream
-            PaStreamParameters i_params = { device_index, params.i_chans, paFloat32, device_ptr->defaultLowInputLatency, nullptr };
-            PaStreamParameters o_params = { device_index, params.o_chans, paFloat32, device_ptr->defaultLowOutputLatency, nullptr };
-            if_err_throw(Pa_OpenStream(&m_stream, &i_params, &o_params, f64(params.rate), params.frames_per_buffer, paNoFlag, cb, userdata), 
-                "Pa_OpenStream failed:\n");
+    // the device portaudio thinks best: the one named "pulse", or else the default one
+    std::unique_ptr<backend> open_device(const stream_params_t& params, PaStreamCallback* cb, void* userdata);
+    // see simulated_device.hpp
+    std::unique_ptr<backend> open_simulated_device(const stream_params_t& params, const simulation& sim, PaStreamCallback* cb,
+        void* userdata);
 
+    class async_stream {
+    protected:
+        std::unique_ptr<backend> m_backend;
+    public:
+        async_stream(stream_params_t params, PaStreamCallback* cb, void* userdata = nullptr)
+            : m_backend(params.simulated ? open_simulated_device(params, *params.simulated, cb, userdata) : open_device(params, cb, userdata)) {
             if(params.start) this->start();
         }
-        
+
         async_stream(stream_params_t p, PaStreamCallback* cb, auto& userdata) : async_stream(p, cb, reinterpret_cast<void*>(&userdata)){}
 
 
-        inline void start() {
-            if_err_throw(Pa_StartStream(m_stream), "Portaudio stream starting error:\n");
-        }
-        ~async_stream() {
-            if_err_throw(Pa_CloseStream(m_stream), "Portaudio stream closing error:\n");
-            if_err_throw(Pa_Terminate(), "PortAudio termination error:\n");
-        }
+        inline void start() { m_backend->start(); }
 
-        PaStream* ptr() { return m_stream; }
+        //null for a simulated device
+        PaStream* ptr() { return m_backend->pa_stream(); }
     };
 
     class synchronous_stream : public async_stream {
     public:
-        synchronous_stream(stream_params_t params, void* userdata = nullptr) 
+        synchronous_stream(stream_params_t params, void* userdata = nullptr)
             : async_stream(params, nullptr, userdata) {}
-        synchronous_stream(stream_params_t params, auto& userdata) 
+        synchronous_stream(stream_params_t params, auto& userdata)
             : async_stream(params, nullptr, userdata) {}
 
-        inline void write(const f32* buf, u64 frames) {
-            if_err_throw(Pa_WriteStream(m_stream, buf, frames), "Error writing to stream\n");
-        }
+        inline void write(const f32* buf, u64 frames) { m_backend->write(buf, frames); }
         template<size_t sz>
         inline void write(const std::array<f32, sz>& buf) {
             write(buf.data(), sz);
@@ -91,9 +78,7 @@ namespace portaudio {
             write(&v, 1);
         }
 
-        inline void read(f32* buf, u64 frames) {
-            if_err_throw(Pa_ReadStream(m_stream, buf, frames), "Error reading from stream\n");
-        }
+        inline void read(f32* buf, u64 frames) { m_backend->read(buf, frames); }
         template<size_t sz>
         inline std::array<f32, sz> read() {
             std::array<f32, sz> buf;
@@ -4,7 +4,6 @@
 #include <boost/fiber/channel_op_status.hpp>
 #include <scluk/language_extension.hpp>
 #include <thread>
-#include <complex>
 #include "sdl/form.hpp"
 #include "audio_params.hpp"
 
@@ -16,15 +15,18 @@ class sdl_gui_thread : std::jthread {
     struct gui_info_t { 
         bool do_output_audio = true, do_apply_effect = false, do_print = false, do_exit = false;
         i32 pitch = 12;
+        dft::window_type window = dft::window_type::hann;
         gui_info_t(){}
     } data;
 
-    audio::gui_simplex_chan channel;
+    //spectra to draw come in through channel, and the buffers they came in go back through recycle once they are
+    //replaced, so that the sender never has to allocate new ones
+    audio::gui_simplex_chan channel, recycle;
     sdl_gui_thread(gui_info_t gui_data = gui_info_t()) 
-        : std::jthread(&sdl_gui_thread::run, this), data(gui_data), channel(16){}
+        : std::jthread(&sdl_gui_thread::run, this), data(gui_data), channel(16), recycle(16){}
 
     private:
-    audio::dft_array hrm_arr;
+    audio::spectrum_buffer hrm_arr, incoming;
 
     void run() {
         using namespace std::chrono_literals;
@@ -36,28 +38,26 @@ class sdl_gui_thread : std::jthread {
         win.set_text_color(sdl::color::black, bg);
 
         win.set_draw_cb([this, &font, bg](sdl::window& w) {
-            if(channel.try_pop(hrm_arr) == boost::fibers::channel_op_status::success) {
+            if(channel.try_pop(incoming) == boost::fibers::channel_op_status::success) {
+                hrm_arr.swap(incoming);
+                recycle.try_push(std::move(incoming));
                 w.clear(bg);
 
-                //find amplitude and freq of main harmonic
-                const u64 N = hrm_arr.size()/2;
+                //find amplitude of main harmonic; the buffer holds the magnitudes of the non-redundant half of the
+                //spectrum, as many as the window size of the vocoder makes
+                const u64 N = hrm_arr.size();
 
-                u64 max_index = 0;
-                f32 max_norm = 0.f;
+                f32 max_ampl = 0.f;
                 for(u64 i : range(N))
-                    if(f32 norm = std::norm(hrm_arr[i]); norm > max_norm) {
-                        max_norm = norm;
-                        max_index = i;
-                    }
-                f32 max_ampl = std::abs(hrm_arr[max_index]);
+                    max_ampl = std::max(max_ampl, hrm_arr[i]);
                 //draw the spectrum
                 i32 min_y = 60;
                 i32 max_y = w.res.y-10;
                 f32 max_h = std::max(f32(max_y - min_y), 0.f);
                 sdl::rect r { .x = 0, .y = max_y, .w = std::max(1, (w.res.x-20) / i32(N)), .h = 0 };
 
-                for(u64 i : range(hrm_arr.size()/2)) {
-                    r.h = -std::min(i32(max_h), i32(max_h * std::abs(hrm_arr[i]) / max_ampl));
+                for(u64 i : range(N)) {
+                    r.h = max_ampl > 0.f ? -std::min(i32(max_h), i32(max_h * hrm_arr[i] / max_ampl)) : 0;
                     r.x = 10 + i32(i) * r.w;
                     if(r.x > w.res.x - 10) break;
                     w.set_draw_color(i%2 ? sdl::color(0x7a, 0x9e, 0xb7, 0xff) : sdl::color(0x7a, 0x76, 0xb7, 0xff));
@@ -67,8 +67,9 @@ class sdl_gui_thread : std::jthread {
             //draw text
             auto yn = [](bool b) -> const char* { return b ? "yes" : "no"; };
             w.draw_text(font, 
-                sout("[P] Printing: %\n[A] Audio output: %\n[F] Effect: %; %% semitones",  
-                yn(data.do_print), yn(data.do_output_audio), yn(data.do_apply_effect), data.pitch < 0 ? "-" : "+", abs(data.pitch)), 
+                sout("[P] Printing: %\n[A] Audio output: %\n[F] Effect: %; %% semitones\n[W] Window: %",  
+                yn(data.do_print), yn(data.do_output_audio), yn(data.do_apply_effect), data.pitch < 0 ? "-" : "+", abs(data.pitch),
+                dft::window_name(data.window)), 
                 { 20, 10 });
         });
 
@@ -94,6 +95,10 @@ class sdl_gui_thread : std::jthread {
                             data.do_apply_effect = !data.do_apply_effect;
                     }
                     break;
+                case SDLK_w:
+                    if(e.type == SDL_KEYDOWN)
+                        data.window = dft::window_types[(u64(data.window) + 1) % dft::window_types.size()];
+                    break;
                 case SDLK_f:
                     if(e.type == SDL_KEYDOWN) 
                         data.do_apply_effect = !data.do_apply_effect;
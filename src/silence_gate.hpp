@@ -0,0 +1,50 @@
+#ifndef SILENCE_GATE_HPP
+#define SILENCE_GATE_HPP
+
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <scluk/aliases.hpp>
+
+using namespace scluk::type_aliases;
+
+// tells when the hops of a channel can skip processing altogether: once gate_hops silent hops in a row have gone in,
+// whatever processes them only has silence left to put out. Hops peaking at or below the threshold are silent; the
+// default only counts digital silence, and a negative threshold turns the gate off
+template<u32 gate_hops>
+class silence_gate {
+    f32 threshold = 0.f;
+    //the silent hops in a row of every channel
+    std::vector<u32> quiet_hops;
+public:
+    //what to do with a hop of a channel: process it, process it starting over (the state from before the silence is
+    //of no use), or skip it and put out silence
+    enum class verdict : u8 { process, restart, skip };
+
+    explicit silence_gate(u16 channels) : quiet_hops(channels, 0) {}
+
+    void set_threshold(f32 t) { threshold = t; }
+    void reset() { std::fill(quiet_hops.begin(), quiet_hops.end(), 0); }
+
+    template<std::size_t n>
+    bool is_silent(const std::array<f32, n>& hop) const {
+        f32 p = 0.f;
+        for(f32 x : hop) p = std::max(p, std::abs(x));
+        return p <= threshold;
+    }
+
+    //counts a hop of channel c in or out of the silence
+    verdict count(u16 c, bool silent) {
+        if(threshold < 0.f) return verdict::process;
+        if(!silent) {
+            const bool was_gated = quiet_hops[c] >= gate_hops;
+            quiet_hops[c] = 0;
+            return was_gated ? verdict::restart : verdict::process;
+        }
+        quiet_hops[c] = std::min(quiet_hops[c] + 1, gate_hops);
+        return quiet_hops[c] == gate_hops ? verdict::skip : verdict::process;
+    }
+};
+
+#endif //SILENCE_GATE_HPP
@@ -0,0 +1,73 @@
+#ifndef TELEMETRY_HISTOGRAM_HPP
+#define TELEMETRY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <scluk/aliases.hpp>
+
+namespace telemetry {
+    using namespace scluk::type_aliases;
+
+    // HDR style histogram of durations in nanoseconds: exact below 64 ns, then 32 log-linear buckets per power of two,
+    // so that every value is within ~3% of its bucket, from nanoseconds to minutes in a fixed array of counters.
+    // Recording is wait-free and may happen on any number of threads at once; readers see every count eventually,
+    // not necessarily all of a record at the same time, which is fine for statistics
+    class histogram {
+    public:
+        //log2 of the buckets per power of two
+        static constexpr u32 precision_bits = 5;
+        static constexpr u32 sub_buckets = 1u << precision_bits;
+        //values at or above 2^max_bits (about 18 minutes) land in the last bucket
+        static constexpr u32 max_bits = 40;
+        static constexpr u32 n_buckets = (max_bits - precision_bits + 1) * sub_buckets;
+
+        static constexpr u32 bucket_of(u64 v) {
+            if(v >= u64(1) << max_bits) return n_buckets - 1;
+            if(v < 2 * sub_buckets) return u32(v);
+            const u32 shift = u32(std::bit_width(v)) - 1 - precision_bits;
+            return (shift + 1) * sub_buckets + u32(v >> shift) - sub_buckets;
+        }
+        //the smallest value of a bucket
+        static constexpr u64 lowest_of(u32 bucket) {
+            if(bucket < 2 * sub_buckets) return bucket;
+            const u32 shift = bucket / sub_buckets - 1;
+            return u64(bucket % sub_buckets + sub_buckets) << shift;
+        }
+    private:
+        std::array<std::atomic<u64>, n_buckets> counts {};
+        std::atomic<u64> n = 0, sum = 0, max_v = 0;
+    public:
+        void record(u64 ns) {
+            counts[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+            n.fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(ns, std::memory_order_relaxed);
+            for(u64 m = max_v.load(std::memory_order_relaxed); ns > m && !max_v.compare_exchange_weak(m, ns, std::memory_order_relaxed);) {}
+        }
+
+        u64 count() const { return n.load(std::memory_order_relaxed); }
+        u64 max() const { return max_v.load(std::memory_order_relaxed); }
+        f64 mean() const {
+            const u64 c = count();
+            return c ? f64(sum.load(std::memory_order_relaxed)) / f64(c) : 0.;
+        }
+        //the value below which a fraction q of the recorded values fall, to the precision of the buckets (the top of
+        //the bucket it falls in, so as not to understate it)
+        u64 percentile(f64 q) const {
+            u64 total = 0;
+            for(const std::atomic<u64>& c : counts) total += c.load(std::memory_order_relaxed);
+            if(!total) return 0;
+            const u64 rank = std::max<u64>(1, u64(q * f64(total) + .5));
+            u64 seen = 0;
+            for(u32 b = 0; b < n_buckets; b++)
+                if((seen += counts[b].load(std::memory_order_relaxed)) >= rank)
+                    return b + 1 < n_buckets ? std::min(lowest_of(b + 1) - 1, max()) : max();
+            return max();
+        }
+    };
+    static_assert(histogram::bucket_of(histogram::lowest_of(histogram::n_buckets - 1)) == histogram::n_buckets - 1);
+    static_assert(histogram::bucket_of(histogram::lowest_of(100)) == 100 && histogram::bucket_of(histogram::lowest_of(101) - 1) == 100);
+}
+
+#endif //TELEMETRY_HISTOGRAM_HPP
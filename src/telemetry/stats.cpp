@@ -0,0 +1,60 @@
+#include "stats.hpp"
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <scluk/language_extension.hpp>
+
+namespace telemetry {
+    std::string report(const audio_stats& stats) {
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-13s %10s %9s %9s %9s %9s %9s   (us, hop budget %.1f us)\n",
+            "stage", "count", "mean", "p50", "p99", "p99.9", "max", stats.hop_budget_ns / 1e3);
+        std::string ret = line;
+        for(stage s : stages) {
+            const histogram& h = stats.timing(s);
+            if(!h.count()) continue;
+            std::snprintf(line, sizeof(line), "%-13s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f\n", stage_name(s),
+                (unsigned long long)(h.count()), h.mean() / 1e3, f64(h.percentile(.5)) / 1e3, f64(h.percentile(.99)) / 1e3,
+                f64(h.percentile(.999)) / 1e3, f64(h.max()) / 1e3);
+            ret += line;
+        }
+        std::snprintf(line, sizeof(line), "late callbacks: %llu", (unsigned long long)(stats.late_callbacks.load()));
+        return ret + line;
+    }
+
+    void write_chrome_trace(const audio_stats& stats, const std::filesystem::path& path) {
+        const trace_buffer* trace = stats.get_trace();
+        if(!trace)
+            throw std::runtime_error("no trace was recorded");
+        std::ofstream f(path);
+        if(!f)
+            throw std::runtime_error("can't write the trace to " + path.string());
+
+        //complete ("X") events, with timestamps and durations in microseconds
+        f << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+        bool first = true;
+        char event[200];
+        trace->for_each([&](const trace_buffer::event& e) {
+            std::snprintf(event, sizeof(event), "%s{\"name\":\"%s %u\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                first ? "" : ",\n", stage_name(e.s), u32(e.channel), stage_name(e.s), f64(e.start_ns) / 1e3, f64(e.duration_ns) / 1e3, u32(e.thread));
+            f << event;
+            first = false;
+        });
+        f << "\n]}\n";
+        if(!f)
+            throw std::runtime_error("can't write the trace to " + path.string());
+    }
+
+    reporter::reporter(const audio_stats& stats, std::chrono::milliseconds period, std::function<std::string()> extra)
+        : thread([&stats, period, extra = std::move(extra)](std::stop_token stop) {
+            using namespace scluk::language_extension;
+            std::mutex m;
+            std::condition_variable_any cv;
+            std::unique_lock lock(m);
+            //wakes up early only to stop
+            while(!cv.wait_for(lock, stop, period, [] { return false; }) && !stop.stop_requested())
+                out("%%", report(stats), extra ? "\n" + extra() : std::string());
+        }) {}
+}
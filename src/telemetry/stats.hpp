@@ -0,0 +1,148 @@
+#ifndef TELEMETRY_STATS_HPP
+#define TELEMETRY_STATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <scluk/aliases.hpp>
+#include "histogram.hpp"
+
+// timing of the audio path, cheap enough to leave on while playing: every stage of every hop, and every portaudio
+// callback, goes into a histogram of its own (and optionally into a trace of individual events), with no locks and no
+// allocations, from whatever thread it runs on. A reporter thread prints them every so often
+namespace telemetry {
+    using namespace scluk::type_aliases;
+    using clk = std::chrono::steady_clock;
+
+    enum class stage : u8 {
+        //windowed fft and conversion to polar form
+        analysis,
+        //phase adjustment
+        modification,
+        //conversion back from polar form and pitch scaled ifft
+        ifft,
+        //windowing and overlap-add of the ifft into the output
+        overlap_add,
+        //the whole hop, every channel and stage included
+        hop,
+        //a portaudio callback
+        callback,
+    };
+    constexpr std::array stages = { stage::analysis, stage::modification, stage::ifft, stage::overlap_add, stage::hop, stage::callback };
+
+    constexpr const char* stage_name(stage s) {
+        switch(s) {
+            case stage::analysis: return "analysis";
+            case stage::modification: return "modification";
+            case stage::ifft: return "ifft";
+            case stage::overlap_add: return "overlap-add";
+            case stage::hop: return "hop";
+            case stage::callback: return "callback";
+        }
+        return "?";
+    }
+
+    // the latest events recorded, in a fixed circular buffer: writers claim slots with a single atomic increment and
+    // never wait, overwriting the oldest events once it is full. Only meant to be read once the writers have stopped
+    class trace_buffer {
+    public:
+        struct event {
+            //since the start of the stats
+            u64 start_ns;
+            u32 duration_ns;
+            stage s;
+            u16 channel;
+            //small ids of the threads, in the order they first recorded anything
+            u16 thread;
+        };
+    private:
+        std::unique_ptr<event[]> events;
+        u64 cap;
+        std::atomic<u64> next = 0;
+    public:
+        explicit trace_buffer(u64 capacity) : events(new event[capacity]), cap(capacity) {}
+
+        void record(const event& e) { events[next.fetch_add(1, std::memory_order_relaxed) % cap] = e; }
+
+        //the events still in the buffer, oldest first
+        template<typename F>
+        void for_each(F&& f) const {
+            const u64 end = next.load(std::memory_order_acquire);
+            for(u64 i = end - std::min(end, cap); i < end; i++)
+                f(events[i % cap]);
+        }
+    };
+
+    class audio_stats {
+        std::array<histogram, stages.size()> timings;
+        clk::time_point epoch = clk::now();
+        std::unique_ptr<trace_buffer> trace;
+    public:
+        //the time a frame of audio lasts, and a hop with it: what a hop has to fit in
+        const f64 frame_ns, hop_budget_ns;
+        //callbacks that took longer than the audio they carried lasts
+        std::atomic<u64> late_callbacks = 0;
+
+        // for a stream at rate Hz processed hop frames at a time. trace_capacity is the events kept for
+        // write_chrome_trace(), 0 for no trace at all
+        audio_stats(u32 rate, u32 hop, u64 trace_capacity = 0)
+            : trace(trace_capacity ? std::make_unique<trace_buffer>(trace_capacity) : nullptr), frame_ns(1e9 / f64(rate)),
+              hop_budget_ns(f64(hop) * frame_ns) {}
+
+        void record(stage s, u16 channel, clk::time_point start, clk::time_point end) {
+            const u64 ns = u64(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            timings[u8(s)].record(ns);
+            if(trace)
+                trace->record({ u64(std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count()), u32(ns), s, channel, thread_id() });
+        }
+
+        const histogram& timing(stage s) const { return timings[u8(s)]; }
+        const trace_buffer* get_trace() const { return trace.get(); }
+
+        static u16 thread_id() {
+            static std::atomic<u16> next_id = 0;
+            thread_local const u16 id = next_id.fetch_add(1, std::memory_order_relaxed);
+            return id;
+        }
+    };
+
+    // times its scope as a stage, if there are stats to record it into
+    class scoped_timer {
+        audio_stats* stats;
+        stage s;
+        u16 channel;
+        clk::time_point start;
+    public:
+        scoped_timer(audio_stats* stats, stage s, u16 channel = 0) : stats(stats), s(s), channel(channel) {
+            if(stats) start = clk::now();
+        }
+        scoped_timer(const scoped_timer&) = delete;
+        scoped_timer& operator=(const scoped_timer&) = delete;
+        ~scoped_timer() {
+            if(stats) stats->record(s, channel, start, clk::now());
+        }
+    };
+
+    // a table of the percentiles of every stage recorded so far, in microseconds, against the hop budget
+    std::string report(const audio_stats& stats);
+
+    // writes the trace as a chrome trace (chrome://tracing, or ui.perfetto.dev): one row per thread, one slice per
+    // event, named after its stage and channel. Throws std::runtime_error if the file can't be written or there is
+    // no trace
+    void write_chrome_trace(const audio_stats& stats, const std::filesystem::path& path);
+
+    // prints report() and whatever extra() returns every period, from a thread of its own
+    class reporter {
+        std::jthread thread;
+    public:
+        reporter(const audio_stats& stats, std::chrono::milliseconds period, std::function<std::string()> extra = {});
+    };
+}
+
+#endif //TELEMETRY_STATS_HPP
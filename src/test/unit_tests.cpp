@@ -0,0 +1,285 @@
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <algorithm>
+#include <memory>
+#include <numbers>
+#include <random>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <scluk/language_extension.hpp>
+#include <scluk/modern_print.hpp>
+
+#include "../dft/fft.hpp"
+#include "../dft/sliding_dft.hpp"
+#include "../dft/overlap_add.hpp"
+#include "../dft/window.hpp"
+#include "../dft/simd.hpp"
+#include "../lockfree/spsc_ring.hpp"
+#include "../phase_vocoder.hpp"
+#include "../any_vocoder.hpp"
+
+// checks of the parts of the vocoder whose results can be told right from wrong exactly, against naive
+// implementations: the ffts, the pitch shifted ifft, the overlap-add, the vocoder at pitch 1 and the ring buffer.
+// Exits with the number of failed checks
+namespace {
+    using namespace scluk::language_extension;
+    using cpx = std::complex<f64>;
+
+    u32 failures = 0;
+
+    void check(bool ok, const std::string& what) {
+        if(ok) return;
+        failures++;
+        out("FAILED: %", what);
+    }
+
+    //largest difference between two sequences, relative to the largest magnitude of the second one
+    template<typename A, typename B>
+    f64 relative_error(const A& a, const B& b) {
+        f64 err = 0, scale = 1e-30;
+        for(std::size_t i = 0; i < std::size(b); i++) {
+            err = std::max(err, f64(std::abs(cpx(a[i]) - cpx(b[i]))));
+            scale = std::max(scale, f64(std::abs(cpx(b[i]))));
+        }
+        return err / scale;
+    }
+
+    //sum_j x[j] * e^(sign*i*2pi*j*k/n), in long double
+    std::vector<cpx> naive_dft(const std::vector<cpx>& x, int sign) {
+        const std::size_t n = x.size();
+        std::vector<cpx> y(n);
+        for(std::size_t k = 0; k < n; k++) {
+            std::complex<long double> acc = 0;
+            for(std::size_t j = 0; j < n; j++) {
+                const long double a = sign * 2.l * std::numbers::pi_v<long double> * (long double)((j * k) % n) / (long double)n;
+                acc += std::complex<long double>(x[j]) * std::complex<long double>(std::cos(a), std::sin(a));
+            }
+            y[k] = cpx(acc);
+        }
+        return y;
+    }
+
+    std::vector<cpx> noise(std::size_t n, u32 seed, bool real) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<f64> d(-1., 1.);
+        std::vector<cpx> x(n);
+        for(cpx& v : x) v = real ? cpx(d(rng)) : cpx(d(rng), d(rng));
+        return x;
+    }
+
+    //power of two (the ones below the simd split size too), mixed radix and Bluestein sizes
+    constexpr std::size_t fft_sizes[] = { 8, 256, 1024, 15, 360, 768, 97, 683, 1366 };
+
+    template<std::floating_point T>
+    void test_fft(const std::string& kernels) {
+        for(std::size_t n : fft_sizes) {
+            const std::vector<cpx> x = noise(n, u32(n), false), expected = naive_dft(x, -1);
+            std::vector<std::complex<T>> y(x.begin(), x.end());
+            const dft::fft_plan<T>& plan = dft::fft_plan<T>::get(n);
+            plan.forward(y.data());
+            const f64 tolerance = std::same_as<T, f32> ? 1e-5 : 1e-12;
+            check(relative_error(y, expected) < tolerance, sout("fft/forward/%/% against the naive dft", n, kernels));
+
+            plan.inverse(y.data());
+            check(relative_error(y, x) < tolerance, sout("fft/inverse/%/% round trip", n, kernels));
+        }
+    }
+
+    void test_real_fft(const std::string& kernels) {
+        for(std::size_t n : fft_sizes) {
+            const std::vector<cpx> x = noise(n, u32(n) + 1, true), expected = naive_dft(x, -1);
+            std::vector<f32> frames(n);
+            for(std::size_t i = 0; i < n; i++) frames[i] = f32(x[i].real());
+            std::vector<std::complex<f32>> spectrum(n/2 + 1);
+
+            const dft::real_fft_plan<f32>& plan = dft::real_fft_plan<f32>::get(n);
+            plan.forward(frames.data(), spectrum.data());
+            check(relative_error(spectrum, std::span(expected).first(n/2 + 1)) < 1e-5,
+                sout("real_fft/forward/%/% against the naive dft", n, kernels));
+
+            std::vector<f32> back(n);
+            plan.inverse(spectrum.data(), back.data());
+            check(relative_error(back, frames) < 1e-5, sout("real_fft/inverse/%/% round trip", n, kernels));
+        }
+    }
+
+    //dft_array::ifft as the original implementation had it: the whole spectrum of the window (the mirrored half
+    //included) copied into a period of N/pitch_factor frames, a complex inverse, and its real part repeated
+    std::vector<f64> baseline_ifft(const std::vector<cpx>& full_spectrum, f32 pitch_factor, std::size_t len) {
+        const std::size_t N = full_spectrum.size(), n = std::size_t(f32(N) / pitch_factor);
+        std::vector<cpx> harmonics(n, 0.);
+        std::copy_n(full_spectrum.begin(), std::min(N, n), harmonics.begin());
+        const std::vector<cpx> frames = naive_dft(harmonics, 1);
+        std::vector<f64> out(len);
+        for(std::size_t i = 0; i < len; i++) out[i] = frames[i % n].real() / f64(n);
+        return out;
+    }
+
+    //what dft_array::ifft is meant to compute: the spectrum as that of a real signal (every bin standing for itself
+    //and its mirror image) over a period of n frames, scaled by n/N so that every harmonic keeps its amplitude
+    std::vector<f64> hermitian_ifft(const std::vector<cpx>& full_spectrum, std::size_t n, std::size_t len) {
+        const std::size_t N = full_spectrum.size(), bins = std::min(N/2 + 1, n/2 + 1);
+        std::vector<cpx> harmonics(n, 0.);
+        for(std::size_t k = 0; k < bins; k++) {
+            harmonics[k] = full_spectrum[k] * (f64(n) / f64(N));
+            if(k && n - k != k) harmonics[n - k] = std::conj(harmonics[k]);
+        }
+        const std::vector<cpx> frames = naive_dft(harmonics, 1);
+        std::vector<f64> out(len);
+        for(std::size_t i = 0; i < len; i++) out[i] = frames[i % n].real() / f64(n);
+        return out;
+    }
+
+    template<u32 N>
+    void test_ifft(const std::string& kernels) {
+        using dft_array = dft::dft_array<f32, N>;
+        const std::vector<cpx> x = noise(N, N + 2, true), full_spectrum = naive_dft(x, -1);
+        dft_array spectrum;
+        for(u32 k = 0; k < dft_array::bins; k++) spectrum[k] = std::complex<f32>(full_spectrum[k]);
+
+        typename dft_array::ifft_workspace ws;
+        std::vector<f32> out(N);
+        spectrum.ifft(1.f, out, ws);
+        check(relative_error(out, baseline_ifft(full_spectrum, 1.f, N)) < 1e-5, sout("dft_array<%>::ifft/0st/% against the baseline", N, kernels));
+        check(relative_error(out, x) < 1e-5, sout("dft_array<%>::ifft/0st/% round trip", N, kernels));
+
+        //away from pitch 1 the baseline lost the mirror image of every harmonic past the period, and folded the bins
+        //it did copy back in as stray partials, so the reference is the real spectrum it stood for instead
+        for(i32 semitones : { -12, -5, -3, 2, 5, 7, 12 }) {
+            const f32 pitch_factor = std::pow(2.f, f32(semitones) / 12.f);
+            spectrum.ifft(pitch_factor, out, ws);
+            check(relative_error(out, hermitian_ifft(full_spectrum, dft_array::period(pitch_factor), N)) < 1e-5,
+                sout("dft_array<%>::ifft/%st/% against the hermitian inverse", N, semitones, kernels));
+        }
+    }
+
+    void test_ifft_period() {
+        using dft_array = dft::dft_array<f32, 1024>;
+        check(dft::nearest_smooth_size(767.1) == 768, "nearest_smooth_size(767.1) == 768");
+        check(dft::nearest_smooth_size(97.) == 96, "nearest_smooth_size(97) == 96");
+        check(dft_array::period(1.f) == 1024, "period at 0 semitones");
+        check(dft_array::period(std::pow(2.f, 5.f / 12.f)) == 768, "period at +5 semitones is smooth");
+        check(dft_array::period(std::pow(2.f, -12.f / 12.f)) == 2048, "period at -12 semitones");
+        //1366 frames is 2 * 683, and no smooth size is within 4 cents of it
+        check(dft_array::period(std::pow(2.f, -5.f / 12.f)) == 1366, "period at -5 semitones keeps the exact length");
+    }
+
+    //frames windowed by an analysis window and overlap-added with the synthesis window that goes with it come out as
+    //the constant signal they were cut from once the overlap-add is full
+    template<u32 N, u32 overlap>
+    void test_overlap_add(dft::window_type w) {
+        dft::overlap_add<f32, N, overlap> ola;
+        const std::array<f32, N>& analysis = dft::window_table<f32, N>(w);
+        const std::array<f32, N>& synthesis = dft::synthesis_window_table<f32, N, overlap>(w);
+        std::array<f32, N / overlap> hop;
+        f64 err = 0;
+        for(u32 h = 0; h < 4 * overlap; h++) {
+            ola.add(analysis.data(), synthesis.data());
+            ola.emit(hop);
+            if(h >= overlap - 1)
+                for(f32 s : hop) err = std::max(err, std::abs(f64(s) - 1.));
+        }
+        check(err < 1e-5, sout("overlap_add<%, %>/% is unity gain", N, overlap, dft::window_name(w)));
+    }
+
+    //the whole vocoder at pitch 1 gives back its input, latency() samples late
+    template<u32 win, u32 overlap>
+    void test_vocoder_identity(const std::string& kernels) {
+        phase_vocoder<win, overlap> vocoder;
+        std::vector<f32> in(win * 16), out(in.size());
+        for(u32 i : index(in)) in[i] = .5f * std::sin(f32(i) * .05f) + .25f * std::sin(f32(i) * .31f);
+        vocoder.process(in, out);
+        f64 err = 0;
+        for(std::size_t i = 2 * win; i < in.size(); i++)
+            err = std::max(err, std::abs(f64(out[i]) - f64(in[i - vocoder.latency()])));
+        check(err < 1e-3, sout("phase_vocoder<%, %>/% at pitch 1 is a delay line", win, overlap, kernels));
+    }
+
+    //the same for every window size, overlap and window make_vocoder() can be asked for
+    void test_any_vocoder_identity() {
+        for(u32 win : any_vocoder::window_sizes)
+            for(u32 overlap : any_vocoder::overlaps)
+                for(dft::window_type w : dft::window_types) {
+                    std::unique_ptr<any_vocoder> vocoder = make_vocoder(win, overlap, 1);
+                    vocoder->set_window(w);
+                    std::vector<f32> in(win * 16), out(in.size());
+                    for(u32 i : index(in)) in[i] = .5f * std::sin(f32(i) * .05f) + .25f * std::sin(f32(i) * .31f);
+                    vocoder->process(in, out);
+                    f64 err = 0;
+                    for(std::size_t i = 2 * win; i < in.size(); i++)
+                        err = std::max(err, std::abs(f64(out[i]) - f64(in[i - vocoder->latency()])));
+                    check(err < 1e-3, sout("make_vocoder(%, %)/% at pitch 1 is a delay line", win, overlap, dft::window_name(w)));
+                }
+    }
+
+    void test_spsc_ring() {
+        lockfree::spsc_ring<u32, 8> ring;
+        u32 next_in = 0, next_out = 0;
+        bool in_order = true;
+        //pushes and pops of sizes that don't divide the capacity, so that both indices wrap at every position
+        for(u32 round = 0; round < 100; round++) {
+            std::array<u32, 5> chunk;
+            const std::size_t n = 1 + round % chunk.size();
+            for(std::size_t i = 0; i < n; i++) chunk[i] = next_in + u32(i);
+            if(ring.push(std::span<const u32>(chunk.data(), n))) next_in += u32(n);
+            else check(ring.space() < n, "spsc_ring refuses a push only when it is full");
+
+            std::array<u32, 3> popped;
+            const std::size_t m = ring.pop_some(std::span(popped).first(1 + round % popped.size()));
+            for(std::size_t i = 0; i < m; i++) in_order &= popped[i] == next_out++;
+        }
+        check(in_order, "spsc_ring pops in order across wrap-arounds");
+        check(ring.size() == next_in - next_out, "spsc_ring size after wrap-arounds");
+
+        u32 v;
+        while(ring.pop(v)) in_order &= v == next_out++;
+        check(in_order && next_out == next_in, "spsc_ring drains in order");
+        check(!ring.pop(v), "spsc_ring pop fails when empty");
+        for(u32 i = 0; i < 8; i++) ring.push(i);
+        check(!ring.push(8u), "spsc_ring push fails when full");
+
+        //the same from two threads, with a producer that has to wait for room all the time
+        lockfree::spsc_ring<u32, 16> shared;
+        constexpr u32 count = 200000;
+        std::thread producer([&] {
+            for(u32 i = 0; i < count;)
+                if(shared.push(i)) i++;
+                else std::this_thread::yield();
+        });
+        bool ordered = true;
+        for(u32 i = 0; i < count;)
+            if(shared.pop(v)) ordered &= v == i++;
+            else std::this_thread::yield();
+        producer.join();
+        check(ordered, "spsc_ring pops in order across threads");
+    }
+}
+
+int main() {
+    for(const dft::simd::kernels_t* k : dft::simd::available_kernels()) {
+        dft::simd::use_kernels(*k);
+        test_fft<f32>(k->name);
+        test_real_fft(k->name);
+        test_ifft<1024>(k->name);
+        test_ifft<512>(k->name);
+        test_vocoder_identity<1024, 4>(k->name);
+    }
+    test_fft<f64>("scalar");
+    test_ifft_period();
+    for(dft::window_type w : dft::window_types) {
+        test_overlap_add<1024, 2>(w);
+        test_overlap_add<1024, 4>(w);
+        test_overlap_add<1024, 8>(w);
+        test_overlap_add<256, 4>(w);
+    }
+    test_any_vocoder_identity();
+    test_spsc_ring();
+
+    if(failures) out("% checks failed", failures);
+    else out("all checks passed");
+    return int(failures);
+}